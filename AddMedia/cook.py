@@ -8,6 +8,8 @@ import requests
 from pathlib import Path
 import subprocess
 
+from covers import generate_cover_variants
+
 
 def get_resolution_category(file_path):
     try:
@@ -72,6 +74,8 @@ def fetch_metadata(imdb_id, api_key, base_url, folder_path = None, collection_ti
                         file.write(chunk)
                 print(f"Image saved successfully as {file_path}")
 
+                generate_cover_variants(file_path)
+
             except requests.RequestException as e:
                 print(f"Error downloading image: {e}")
         else:
@@ -0,0 +1,42 @@
+import os
+import subprocess
+
+# Widths the clients actually draw covers at (phone grid, tablet/TV grid)
+VARIANT_WIDTHS = [200, 400]
+
+# Extension -> ffmpeg encoder arguments
+VARIANT_FORMATS = {
+    'jpg': ["-q:v", "4"],
+    'webp': ["-c:v", "libwebp", "-quality", "80"],
+}
+
+
+def generate_cover_variants(image_path):
+    """
+    Create the resized covers the server negotiates between.
+    For <id>.png this writes <id>.w<width>.<jpg|webp> next to it.
+    """
+    base, _ = os.path.splitext(image_path)
+
+    for width in VARIANT_WIDTHS:
+        for extension, codec_args in VARIANT_FORMATS.items():
+            output_file = f"{base}.w{width}.{extension}"
+
+            # Never upscale: min() keeps small posters at their own width
+            ffmpeg_cmd = [
+                "ffmpeg",
+                "-v", "error",
+                "-i", image_path,
+                "-vf", f"scale='min({width},iw)':-2",
+                *codec_args,
+                "-y",
+                output_file
+            ]
+
+            try:
+                subprocess.run(ffmpeg_cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True, check=True)
+            except (subprocess.CalledProcessError, FileNotFoundError) as e:
+                print(f"Error creating cover variant {output_file}: {e}")
+                continue
+
+    print(f"Cover variants created for {image_path}")
@@ -0,0 +1,74 @@
+#include "CatalogCache.h"
+#include <iostream>
+
+CatalogCache::CatalogCache(DatabaseHandler& dbHandler, std::chrono::milliseconds pollInterval, long long changeLogSize)
+    : db(dbHandler), pollInterval(pollInterval), changeLogSize(changeLogSize), snapshot(std::make_shared<const CatalogSnapshot>()) {
+    refreshIfChanged();
+    poller = std::thread(&CatalogCache::pollLoop, this);
+}
+
+CatalogCache::~CatalogCache() {
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        stopping = true;
+    }
+    stopCondition.notify_all();
+    if (poller.joinable()) {
+        poller.join();
+    }
+}
+
+std::shared_ptr<const CatalogSnapshot> CatalogCache::current() const {
+    return std::atomic_load(&snapshot);
+}
+
+void CatalogCache::refreshIfChanged() {
+    std::lock_guard<std::mutex> lock(refreshMutex);
+    try {
+        long long dataVersion = db.getDataVersion();
+        if (dataVersion != lastDataVersion) {
+            rebuild(dataVersion);
+        }
+    }
+    catch (const std::exception& e) {
+        // Keep serving the last good snapshot
+        std::cerr << "Failed to refresh catalog: " << e.what() << std::endl;
+    }
+}
+
+void CatalogCache::rebuild(long long dataVersion) {
+    // Everything below reads the replica, so it sees one consistent copy
+    db.refreshReplica();
+
+    auto next = std::make_shared<CatalogSnapshot>();
+    next->version = db.getCatalogVersion();
+    next->encodings = db.serializeMediaData(next->version);
+    next->etag = "\"catalog-" + std::to_string(next->version) + "\"";
+
+    std::atomic_store(&snapshot, std::shared_ptr<const CatalogSnapshot>(std::move(next)));
+    lastDataVersion = dataVersion;
+    std::cout << "Catalog snapshot rebuilt (version " << current()->version << ")" << std::endl;
+
+    db.pruneCatalogChanges(changeLogSize);
+}
+
+std::string CatalogCache::changesSince(long long since, bool& full) {
+    auto latest = current();
+
+    // Version 0 predates the change log, and a version from the future means
+    // the database was replaced; both need a full resync
+    full = since <= 0 || since > latest->version || since < db.getOldestCatalogDelta();
+    if (full) {
+        return latest->encodings.json;
+    }
+    return db.serializeMediaDataSince(since, latest->version);
+}
+
+void CatalogCache::pollLoop() {
+    std::unique_lock<std::mutex> lock(stopMutex);
+    while (!stopCondition.wait_for(lock, pollInterval, [this] { return stopping; })) {
+        lock.unlock();
+        refreshIfChanged();
+        lock.lock();
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef CATALOGCACHE_H
+#define CATALOGCACHE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "DatabaseHandler.h"
+
+// Pre-serialized media catalog (Collection + Media). Built once, published
+// with an atomic pointer swap and rebuilt only when another connection
+// commits to the database, as reported by PRAGMA data_version. The same
+// check refreshes the database's in-memory catalog replica.
+struct CatalogSnapshot {
+    long long version = 0;      // Latest CatalogChange version included
+    std::string etag;
+    CatalogEncodings encodings;
+};
+
+class CatalogCache {
+public:
+    explicit CatalogCache(DatabaseHandler& dbHandler,
+        std::chrono::milliseconds pollInterval = std::chrono::milliseconds(2000),
+        long long changeLogSize = 10000);
+    ~CatalogCache();
+
+    CatalogCache(const CatalogCache&) = delete;
+    CatalogCache& operator=(const CatalogCache&) = delete;
+
+    std::shared_ptr<const CatalogSnapshot> current() const;
+
+    // Rebuilds the snapshot if the database changed since the last build
+    void refreshIfChanged();
+
+    // Rows changed after `since`, or the full snapshot when the change log
+    // no longer reaches back that far. `full` tells which one was returned.
+    std::string changesSince(long long since, bool& full);
+
+private:
+    void rebuild(long long dataVersion);
+    void pollLoop();
+
+    DatabaseHandler& db;
+    const std::chrono::milliseconds pollInterval;
+    const long long changeLogSize;
+
+    std::shared_ptr<const CatalogSnapshot> snapshot;
+    long long lastDataVersion = -1;
+
+    std::mutex refreshMutex;
+    std::mutex stopMutex;
+    std::condition_variable stopCondition;
+    bool stopping = false;
+    std::thread poller;
+};
+
+#endif // CATALOGCACHE_H
@@ -0,0 +1,283 @@
+#include "ConnectionPool.h"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+// Profile values come from config.json and are pasted into PRAGMA statements
+static const std::string& pragmaKeyword(const std::string& value) {
+    if (value.empty() || !std::all_of(value.begin(), value.end(),
+        [](unsigned char c) { return std::isalnum(c) != 0; })) {
+        throw std::runtime_error("Invalid pragma value: '" + value + "'");
+    }
+    return value;
+}
+
+static std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+ConnectionPool::Lease::Lease(ConnectionPool* pool, Connection* connection, bool writer)
+    : pool(pool), connection(connection), writer(writer) {
+}
+
+ConnectionPool::Lease::Lease(Lease&& other) noexcept
+    : pool(other.pool), connection(other.connection), writer(other.writer) {
+    other.pool = nullptr;
+    other.connection = nullptr;
+}
+
+ConnectionPool::Lease::~Lease() {
+    if (pool) {
+        endLease(*connection);
+        pool->release(connection, writer);
+    }
+}
+
+CppSQLite3DB& ConnectionPool::Lease::operator*() const {
+    return connection->db;
+}
+
+CppSQLite3DB* ConnectionPool::Lease::operator->() const {
+    return &connection->db;
+}
+
+CppSQLite3Statement& ConnectionPool::Lease::statement(const std::string& sql) {
+    return pool->statement(*connection, sql);
+}
+
+void ConnectionPool::Lease::releaseStatements() {
+    endLease(*connection);
+}
+
+ConnectionPool::ConnectionPool(const std::string& dbPath, size_t readerCount, const PragmaProfile& pragmas) {
+    if (readerCount == 0) {
+        // One per crow worker plus the catalog poller and progress flusher
+        readerCount = std::thread::hardware_concurrency() + 2;
+    }
+
+    // The writer goes first: it is the one allowed to create the file
+    writerConnection = std::make_unique<Connection>();
+    writerConnection->db.open(dbPath.c_str(), SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX);
+    // Switching the journal mode takes the write lock, which an ingest
+    // script may be holding
+    writerConnection->db.setBusyTimeout(pragmas.busyTimeoutMs);
+
+    // Switched before any reader opens; SQLite answers with the mode it ended
+    // up in, which stays "delete" on file systems without shared memory
+    std::string journalSql = "PRAGMA journal_mode=" + pragmaKeyword(pragmas.journalMode) + ";";
+    activeJournalMode = lowercase(writerConnection->db.execQuery(journalSql.c_str()).getStringField(0));
+    if (activeJournalMode != lowercase(pragmas.journalMode)) {
+        std::cerr << "Journal mode " << pragmas.journalMode << " not available, using " << activeJournalMode << std::endl;
+    }
+
+    applyPragmas(writerConnection->db, pragmas);
+    if (!pragmas.autoCheckpoint) {
+        writerConnection->db.execDML("PRAGMA wal_autocheckpoint=0;");
+    }
+
+    for (size_t i = 0; i < readerCount; i++) {
+        auto connection = std::make_unique<Connection>();
+        connection->db.open(dbPath.c_str(), SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX);
+        applyPragmas(connection->db, pragmas);
+        idleReaders.push_back(connection.get());
+        readers.push_back(std::move(connection));
+
+        auto replica = std::make_unique<Connection>();
+        replica->db.open(":memory:", SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX);
+        replica->replica = true;
+        idleReplicas.push_back(replica.get());
+        replicas.push_back(std::move(replica));
+    }
+}
+
+void ConnectionPool::applyPragmas(CppSQLite3DB& db, const PragmaProfile& pragmas) {
+    // Readers wait out a rollback-journal commit, the writer an external one
+    db.setBusyTimeout(pragmas.busyTimeoutMs);
+    std::string sql =
+        "PRAGMA synchronous=" + pragmaKeyword(pragmas.synchronous) + ";"
+        "PRAGMA temp_store=" + pragmaKeyword(pragmas.tempStore) + ";"
+        "PRAGMA cache_size=" + std::to_string(-static_cast<long long>(pragmas.cacheSizeKiB)) + ";"
+        "PRAGMA mmap_size=" + std::to_string(pragmas.mmapSize) + ";"
+        "PRAGMA journal_size_limit=" + std::to_string(pragmas.journalSizeLimit) + ";";
+    db.execDML(sql.c_str());
+}
+
+ConnectionPool::Lease ConnectionPool::reader() {
+    std::unique_lock<std::mutex> lock(mutex);
+    available.wait(lock, [this] { return !idleReaders.empty(); });
+    Connection* connection = idleReaders.back();
+    idleReaders.pop_back();
+    return Lease(this, connection, false);
+}
+
+ConnectionPool::Lease ConnectionPool::writer() {
+    std::unique_lock<std::mutex> lock(mutex);
+    available.wait(lock, [this] { return !writerBusy; });
+    writerBusy = true;
+    return Lease(this, writerConnection.get(), true);
+}
+
+ConnectionPool::Lease ConnectionPool::replica() {
+    std::shared_ptr<const std::string> image;
+    unsigned long long generation;
+    Connection* connection;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!replicaImage) {
+            lock.unlock();
+            return reader();
+        }
+        available.wait(lock, [this] { return !idleReplicas.empty(); });
+        connection = idleReplicas.back();
+        idleReplicas.pop_back();
+        image = replicaImage;
+        generation = replicaGeneration;
+    }
+
+    Lease lease(this, connection, false);
+    if (connection->generation != generation) {
+        // Cached statements belong to the old schema
+        connection->bySql.clear();
+        connection->statements.clear();
+        connection->db.deserializeInPlace(*image);
+        connection->generation = generation;
+
+        // Swapped only now, so the previous image outlives the old database;
+        // replicaStats() reads it under the mutex
+        std::lock_guard<std::mutex> lock(mutex);
+        connection->image = std::move(image);
+    }
+    return lease;
+}
+
+void ConnectionPool::refreshReplica() {
+    std::lock_guard<std::mutex> refreshLock(refreshMutex);
+
+    CppSQLite3DB staging;
+    staging.open(":memory:", SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX);
+    {
+        // One read transaction on a reader, so the copy is a consistent
+        // snapshot and never waits on the writer
+        Lease source = reader();
+        staging.backupFrom(*source);
+    }
+
+    // Credentials and watch history stay on disk; VACUUM drops their pages
+    staging.execDML(R"(
+        DROP TABLE IF EXISTS mediaMetadata;
+        DROP TABLE IF EXISTS Profile;
+        DROP TABLE IF EXISTS User;
+        VACUUM;
+    )");
+    auto image = std::make_shared<const std::string>(staging.serialize());
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        replicaImage = std::move(image);
+        ++replicaGeneration;
+    }
+}
+
+ConnectionPool::ReplicaStats ConnectionPool::replicaStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    ReplicaStats stats;
+    stats.generation = replicaGeneration;
+
+    // The current image, plus older ones idle replicas have not swapped out
+    std::vector<const std::string*> images;
+    if (replicaImage) {
+        images.push_back(replicaImage.get());
+    }
+    for (const auto& replica : replicas) {
+        const std::string* image = replica->image.get();
+        if (image && std::find(images.begin(), images.end(), image) == images.end()) {
+            images.push_back(image);
+        }
+    }
+    for (const std::string* image : images) {
+        stats.bytes += image->size();
+    }
+    return stats;
+}
+
+ConnectionPool::StatementStats ConnectionPool::statementStats() const {
+    StatementStats stats;
+    stats.compiled = compiled.load();
+    stats.reused = reused.load();
+    return stats;
+}
+
+CppSQLite3Statement& ConnectionPool::statement(Connection& connection, const std::string& sql) {
+    auto it = connection.bySql.find(sql);
+    if (it != connection.bySql.end()) {
+        CachedStatement& cached = *it->second;
+        if (!cached.inUse) {
+            cached.statement.reset();
+            cached.statement.clearBindings();
+            cached.inUse = true;
+            connection.active.push_back(&cached);
+            connection.statements.splice(connection.statements.begin(), connection.statements, it->second);
+            ++reused;
+            return cached.statement;
+        }
+
+        // The cached one may still be mid-query in this lease; use a private copy
+        connection.uncached.push_back(connection.db.compileStatement(sql.c_str()));
+        ++compiled;
+        return connection.uncached.back();
+    }
+
+    CppSQLite3Statement statement = connection.db.compileStatement(sql.c_str());
+    ++compiled;
+
+    // Evict the least recently used statement that is not handed out
+    if (connection.statements.size() >= statementCacheSize) {
+        for (auto victim = connection.statements.rbegin(); victim != connection.statements.rend(); ++victim) {
+            if (!victim->inUse) {
+                connection.bySql.erase(victim->sql);
+                connection.statements.erase(std::next(victim).base());
+                break;
+            }
+        }
+    }
+
+    connection.statements.push_front(CachedStatement{ sql, std::move(statement), true });
+    connection.bySql[sql] = connection.statements.begin();
+    connection.active.push_back(&connection.statements.front());
+    return connection.statements.front().statement;
+}
+
+void ConnectionPool::endLease(Connection& connection) {
+    for (CachedStatement* cached : connection.active) {
+        try {
+            cached->statement.reset();
+        }
+        catch (const CppSQLite3Exception&) {
+            // reset() reports the error of the last step, which the caller already saw
+        }
+        cached->inUse = false;
+    }
+    connection.active.clear();
+    connection.uncached.clear();
+}
+
+void ConnectionPool::release(Connection* connection, bool writer) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (writer) {
+            writerBusy = false;
+        }
+        else if (connection->replica) {
+            idleReplicas.push_back(connection);
+        }
+        else {
+            idleReaders.push_back(connection);
+        }
+    }
+    available.notify_all();
+}
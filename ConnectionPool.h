@@ -0,0 +1,153 @@
+#ifndef CONNECTIONPOOL_H
+#define CONNECTIONPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "CppSQLite3.h"
+
+// Pragmas applied to every connection when the pool opens it. journal_mode
+// is stored in the database file, so only the writer sets it.
+struct PragmaProfile {
+    std::string journalMode = "WAL";
+    std::string synchronous = "NORMAL";     // Durable in WAL mode except on power loss
+    long long mmapSize = 256LL * 1024 * 1024;
+    int cacheSizeKiB = 8 * 1024;            // Per connection
+    std::string tempStore = "MEMORY";
+    bool autoCheckpoint = true;             // Off when a background thread checkpoints
+    int busyTimeoutMs = 10000;              // Wait on another connection's lock before SQLITE_BUSY
+    long long journalSizeLimit = 64LL * 1024 * 1024;    // WAL truncated back to this once reset; -1 never
+};
+
+// SQLite connections shared by the request workers. Each connection is opened
+// in multi-thread mode (SQLITE_OPEN_NOMUTEX) and used by one thread at a time:
+// a set of read-only connections, handed out one per caller, and a single
+// writer, so writes are serialized in the process instead of fighting over
+// the database lock.
+//
+// Catalog reads can go to replicas instead: in-memory connections loaded
+// from an image of the catalog tables that refreshReplica() takes with the
+// backup API. They never touch the disk or wait on the writer.
+//
+// Connections are checked out with a Lease that gives them back when it goes
+// out of scope. Statements and queries must not outlive their lease.
+class ConnectionPool {
+    struct Connection;
+
+public:
+    struct StatementStats {
+        unsigned long long compiled = 0;
+        unsigned long long reused = 0;
+    };
+
+    struct ReplicaStats {
+        unsigned long long generation = 0;  // Refreshes so far
+        size_t bytes = 0;                   // Images still loaded; replicas share, not copy, them
+    };
+
+    class Lease {
+    public:
+        Lease(Lease&& other) noexcept;
+        ~Lease();
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease& operator=(Lease&&) = delete;
+
+        CppSQLite3DB& operator*() const;
+        CppSQLite3DB* operator->() const;
+
+        // Compiled once per connection and kept for later leases. Comes back
+        // reset with no bindings; it is reset again when the lease ends, so a
+        // half-read query never holds a read transaction open.
+        CppSQLite3Statement& statement(const std::string& sql);
+
+        // Resets every statement handed out so far, as the end of the lease
+        // would, so a long lease can reuse them for the next unit of work
+        void releaseStatements();
+
+    private:
+        friend class ConnectionPool;
+        Lease(ConnectionPool* pool, Connection* connection, bool writer);
+
+        ConnectionPool* pool;
+        Connection* connection;
+        bool writer;
+    };
+
+    // readers = 0 sizes the pool for crow's default worker count
+    explicit ConnectionPool(const std::string& dbPath, size_t readers = 0,
+        const PragmaProfile& pragmas = PragmaProfile());
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    // All block until a connection is free
+    Lease reader();
+    Lease writer();
+    // Falls back to reader() until the first refreshReplica()
+    Lease replica();
+
+    // Copies the database into memory, minus the tables that do not belong
+    // to the catalog, and has every replica load it on its next lease
+    void refreshReplica();
+
+    StatementStats statementStats() const;
+    ReplicaStats replicaStats() const;
+    size_t readerCount() const { return readers.size(); }
+
+    // What the writer reported after setting journal_mode, e.g. "wal"
+    const std::string& journalMode() const { return activeJournalMode; }
+
+private:
+    static const size_t statementCacheSize = 64;
+
+    struct CachedStatement {
+        std::string sql;
+        CppSQLite3Statement statement;
+        bool inUse = false;
+    };
+
+    // Members are destroyed bottom-up, so statements finalize before db
+    // closes, and db closes before the image it reads is released
+    struct Connection {
+        std::shared_ptr<const std::string> image;  // Replica image db reads in place
+        CppSQLite3DB db;
+        std::list<CachedStatement> statements;      // Most recently used first
+        std::unordered_map<std::string, std::list<CachedStatement>::iterator> bySql;
+        std::vector<CachedStatement*> active;       // Handed out in the current lease
+        std::list<CppSQLite3Statement> uncached;    // Nodes never move, so references hold
+        bool replica = false;
+        unsigned long long generation = 0;          // Replica image currently loaded
+    };
+
+    static void applyPragmas(CppSQLite3DB& db, const PragmaProfile& pragmas);
+    CppSQLite3Statement& statement(Connection& connection, const std::string& sql);
+    static void endLease(Connection& connection);
+    void release(Connection* connection, bool writer);
+
+    std::vector<std::unique_ptr<Connection>> readers;
+    std::unique_ptr<Connection> writerConnection;
+    std::vector<std::unique_ptr<Connection>> replicas;
+    std::string activeJournalMode;
+
+    mutable std::mutex mutex;
+    std::condition_variable available;
+    std::vector<Connection*> idleReaders;
+    std::vector<Connection*> idleReplicas;
+    bool writerBusy = false;
+
+    std::mutex refreshMutex;
+    std::shared_ptr<const std::string> replicaImage;
+    unsigned long long replicaGeneration = 0;
+
+    std::atomic<unsigned long long> compiled{ 0 };
+    std::atomic<unsigned long long> reused{ 0 };
+};
+
+#endif // CONNECTIONPOOL_H
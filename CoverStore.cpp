@@ -0,0 +1,324 @@
+#include "CoverStore.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+using json = nlohmann::json;
+namespace fs = std::filesystem;
+
+static std::string contentTypeFor(const fs::path& path) {
+    std::string extension = path.extension().string();
+    for (char& c : extension) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+
+    if (extension == ".png") return "image/png";
+    if (extension == ".jpg" || extension == ".jpeg") return "image/jpeg";
+    if (extension == ".webp") return "image/webp";
+    return "";
+}
+
+// OMDb posters are JPEGs saved as .png, so trust the magic bytes first
+static std::string sniffContentType(const std::string& bytes, const std::string& fallback) {
+    if (bytes.compare(0, 4, "\x89PNG") == 0) return "image/png";
+    if (bytes.compare(0, 3, "\xFF\xD8\xFF") == 0) return "image/jpeg";
+    if (bytes.size() >= 12 && bytes.compare(0, 4, "RIFF") == 0 && bytes.compare(8, 4, "WEBP") == 0) return "image/webp";
+    return fallback;
+}
+
+// "<id>.png" is the original; "<id>.w200.jpg" is a 200 px wide variant
+static std::string parseCoverName(const fs::path& path, int& width) {
+    fs::path stem = path.stem();
+    std::string suffix = stem.extension().string();
+    width = 0;
+    if (suffix.size() > 2 && suffix[1] == 'w' &&
+        suffix.find_first_not_of("0123456789", 2) == std::string::npos) {
+        const char* digits = suffix.data() + 2;
+        auto parsed = std::from_chars(digits, suffix.data() + suffix.size(), width);
+        if (parsed.ec != std::errc() || width <= 0) {
+            width = -1;     // Not a usable variant; the caller skips the file
+            return std::string();
+        }
+        return stem.stem().string();
+    }
+    return stem.string();
+}
+
+static std::shared_ptr<const CoverStore::Cover> loadCover(const fs::path& path, int width, fs::file_time_type mtime, std::uintmax_t size) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return nullptr;
+    }
+
+    auto cover = std::make_shared<CoverStore::Cover>();
+    cover->bytes.resize(static_cast<size_t>(size));
+    file.read(&cover->bytes[0], cover->bytes.size());
+    cover->bytes.resize(static_cast<size_t>(file.gcount()));
+    cover->contentType = sniffContentType(cover->bytes, contentTypeFor(path));
+    cover->fileName = path.filename().string();
+    cover->width = width;
+    cover->mtime = mtime;
+    cover->size = size;
+
+    char etag[48];
+    std::snprintf(etag, sizeof(etag), "\"%llx-%llx\"",
+        static_cast<unsigned long long>(size),
+        static_cast<unsigned long long>(mtime.time_since_epoch().count()));
+    cover->etag = etag;
+    return cover;
+}
+
+// FNV-1a over the sorted (file name, size, mtime) of every cover, cut to 53
+// bits so JavaScript clients read the number back exactly
+static std::uint64_t contentVersion(const CoverStore::CoverMap& covers) {
+    std::vector<const CoverStore::Cover*> files;
+    for (const auto& entry : covers) {
+        for (const auto& cover : entry.second.variants) {
+            files.push_back(cover.get());
+        }
+    }
+    std::sort(files.begin(), files.end(),
+        [](const CoverStore::Cover* a, const CoverStore::Cover* b) { return a->fileName < b->fileName; });
+
+    std::uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+    };
+    for (const CoverStore::Cover* cover : files) {
+        std::uint64_t size = cover->size;
+        long long mtime = static_cast<long long>(cover->mtime.time_since_epoch().count());
+        mix(cover->fileName.data(), cover->fileName.size() + 1);
+        mix(&size, sizeof(size));
+        mix(&mtime, sizeof(mtime));
+    }
+    return hash & ((1ULL << 53) - 1);
+}
+
+CoverStore::CoverStore(const std::string& coversPath, std::chrono::seconds refreshInterval)
+    : coversPath(coversPath), refreshInterval(refreshInterval), covers(std::make_shared<const CoverMap>()) {
+    refresh();
+    std::cout << "Covers loaded: " << snapshot()->size() << std::endl;
+    refresher = std::thread(&CoverStore::refreshLoop, this);
+}
+
+CoverStore::~CoverStore() {
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        stopping = true;
+    }
+    stopCondition.notify_all();
+    if (refresher.joinable()) {
+        refresher.join();
+    }
+}
+
+std::shared_ptr<const CoverStore::CoverMap> CoverStore::snapshot() const {
+    return std::atomic_load(&covers);
+}
+
+std::shared_ptr<const CoverStore::Cover> CoverStore::select(const CoverSet& set, const CoverRequest& request) {
+    std::shared_ptr<const Cover> original;
+    std::shared_ptr<const Cover> best;
+    std::shared_ptr<const Cover> largest;
+
+    for (const auto& cover : set.variants) {
+        if (cover->width == 0) {
+            original = cover;
+            continue;
+        }
+        if (cover->contentType == "image/webp" && !request.acceptWebp) {
+            continue;
+        }
+        if (!largest || cover->width > largest->width) {
+            largest = cover;
+        }
+        // Smallest width that still covers the display, then the fewest bytes
+        if (cover->width >= request.width &&
+            (!best || cover->width < best->width ||
+                (cover->width == best->width && cover->bytes.size() < best->bytes.size()))) {
+            best = cover;
+        }
+    }
+
+    if (request.width <= 0 || !best) {
+        return original ? original : largest;
+    }
+    return best;
+}
+
+std::shared_ptr<const CoverStore::Cover> CoverStore::get(const std::string& id, const CoverRequest& request) const {
+    auto current = snapshot();
+    auto it = current->find(id);
+    return it != current->end() ? select(it->second, request) : nullptr;
+}
+
+void CoverStore::refresh() {
+    std::lock_guard<std::mutex> lock(refreshMutex);
+
+    auto previous = snapshot();
+    std::unordered_map<std::string, std::shared_ptr<const Cover>> previousFiles;
+    for (const auto& entry : *previous) {
+        for (const auto& cover : entry.second.variants) {
+            previousFiles[cover->fileName] = cover;
+        }
+    }
+
+    auto next = std::make_shared<CoverMap>();
+    size_t files = 0;
+    bool changed = false;
+
+    std::error_code ec;
+    for (fs::directory_iterator it(coversPath, ec), end; !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file(ec) || contentTypeFor(it->path()).empty()) {
+            continue;
+        }
+
+        int width = 0;
+        std::string id = parseCoverName(it->path(), width);
+        if (width < 0) {
+            continue;
+        }
+        auto mtime = it->last_write_time(ec);
+        if (ec) continue;
+        auto size = it->file_size(ec);
+        if (ec) continue;
+
+        // Unchanged files keep sharing the buffer from the previous snapshot
+        std::shared_ptr<const Cover> cover;
+        auto old = previousFiles.find(it->path().filename().string());
+        if (old != previousFiles.end() && old->second->mtime == mtime && old->second->size == size) {
+            cover = old->second;
+        }
+        else {
+            cover = loadCover(it->path(), width, mtime, size);
+            if (!cover) {
+                std::cerr << "Failed to load cover: " << it->path().string() << std::endl;
+                continue;
+            }
+            changed = true;
+        }
+
+        (*next)[id].variants.push_back(std::move(cover));
+        ++files;
+    }
+
+    if (ec) {
+        std::cerr << "Failed to scan covers folder: " << ec.message() << std::endl;
+        return;
+    }
+
+    if (!changed && files == previousFiles.size()) {
+        return;
+    }
+
+    std::uint64_t nextVersion = contentVersion(*next);
+    std::atomic_store(&covers, std::shared_ptr<const CoverMap>(std::move(next)));
+    currentVersion.store(nextVersion);
+}
+
+std::string CoverStore::packBundle(const CoverMap& source, const std::vector<std::string>& ids,
+    const CoverRequest& request, std::uint64_t version) {
+    json index;
+    index["version"] = version;
+    index["covers"] = json::array();
+
+    std::vector<std::shared_ptr<const Cover>> parts;
+    size_t offset = 0;
+    for (const auto& id : ids) {
+        auto it = source.find(id);
+        auto cover = (it != source.end()) ? select(it->second, request) : nullptr;
+        if (!cover) {
+            index["missing"].push_back(id);
+            continue;
+        }
+        index["covers"].push_back({
+            { "id", id },
+            { "offset", offset },
+            { "length", cover->bytes.size() },
+            { "type", cover->contentType }
+        });
+        offset += cover->bytes.size();
+        parts.push_back(std::move(cover));
+    }
+
+    std::string header = index.dump();
+    std::uint32_t headerLength = static_cast<std::uint32_t>(header.size());
+
+    std::string bundle;
+    bundle.reserve(4 + header.size() + offset);
+    for (int shift = 0; shift < 32; shift += 8) {
+        bundle += static_cast<char>((headerLength >> shift) & 0xFF);
+    }
+    bundle += header;
+    for (const auto& cover : parts) {
+        bundle += cover->bytes;
+    }
+    return bundle;
+}
+
+std::string CoverStore::buildBundle(const std::vector<std::string>& ids, const CoverRequest& request) const {
+    return packBundle(*snapshot(), ids, request, version());
+}
+
+// Every width between two variant widths picks the same variants, so the
+// request snaps to the narrowest variant that still covers it, or to -1 for
+// "wider than any variant" (the originals). This bounds the bundle cache by
+// the widths on disk instead of the widths clients ask for.
+static int snapWidth(const CoverStore::CoverMap& covers, int width) {
+    if (width <= 0) {
+        return 0;
+    }
+    int snapped = -1;
+    for (const auto& entry : covers) {
+        for (const auto& cover : entry.second.variants) {
+            if (cover->width >= width && (snapped < 0 || cover->width < snapped)) {
+                snapped = cover->width;
+            }
+        }
+    }
+    return snapped;
+}
+
+std::shared_ptr<const std::string> CoverStore::fullBundle(const CoverRequest& request) {
+    std::lock_guard<std::mutex> lock(bundleMutex);
+
+    // Read the version before the snapshot so a concurrent refresh can only
+    // make the cached bundle look older than it is, never newer
+    std::uint64_t current = version();
+    auto covers = snapshot();
+
+    int width = snapWidth(*covers, request.width);
+    std::string key = std::to_string(width) + (request.acceptWebp ? "/webp" : "");
+    auto cached = bundles.find(key);
+    if (cached != bundles.end() && cached->second.version == current) {
+        return cached->second.bytes;
+    }
+
+    // Entries from older versions are never read again
+    for (auto it = bundles.begin(); it != bundles.end();) {
+        it = it->second.version != current ? bundles.erase(it) : std::next(it);
+    }
+
+    std::vector<std::string> ids;
+    ids.reserve(covers->size());
+    for (const auto& entry : *covers) {
+        ids.push_back(entry.first);
+    }
+
+    auto bundle = std::make_shared<const std::string>(packBundle(*covers, ids, request, current));
+    bundles[key] = CachedBundle{ current, bundle };
+    return bundle;
+}
+
+void CoverStore::refreshLoop() {
+    std::unique_lock<std::mutex> lock(stopMutex);
+    while (!stopCondition.wait_for(lock, refreshInterval, [this] { return stopping; })) {
+        lock.unlock();
+        refresh();
+        lock.lock();
+    }
+}
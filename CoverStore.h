@@ -0,0 +1,102 @@
+#ifndef COVERSTORE_H
+#define COVERSTORE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// What the client can display: the width it will draw the cover at and
+// whether it decodes WebP
+struct CoverRequest {
+    int width = 0;              // Display width in pixels, 0 for the original
+    bool acceptWebp = false;
+};
+
+// Every cover under coversPath, held in memory as immutable byte buffers.
+// Lookups read an atomically swapped snapshot; a background thread rescans
+// the folder and reloads only the files whose size or mtime changed.
+//
+// Besides the original <id>.png, the ingest writes resized variants named
+// <id>.w<width>.<jpg|webp>; get() picks the best one for the client.
+class CoverStore {
+public:
+    struct Cover {
+        std::string bytes;
+        std::string contentType;
+        std::string etag;
+        std::string fileName;
+        int width = 0;          // 0 for the original upload
+        std::filesystem::file_time_type mtime;
+        std::uintmax_t size = 0;
+    };
+
+    struct CoverSet {
+        std::vector<std::shared_ptr<const Cover>> variants;
+    };
+
+    using CoverMap = std::unordered_map<std::string, CoverSet>;
+
+    explicit CoverStore(const std::string& coversPath,
+        std::chrono::seconds refreshInterval = std::chrono::seconds(10));
+    ~CoverStore();
+
+    CoverStore(const CoverStore&) = delete;
+    CoverStore& operator=(const CoverStore&) = delete;
+
+    // Returns nullptr if there is no cover for this ID.
+    std::shared_ptr<const Cover> get(const std::string& id, const CoverRequest& request = CoverRequest()) const;
+
+    std::shared_ptr<const CoverMap> snapshot() const;
+
+    // Hash of every cover file's name, size and mtime: the same files give
+    // the same version across restarts, and any change gives a new one.
+    // 0 until the first scan finds a cover.
+    std::uint64_t version() const { return currentVersion.load(); }
+
+    void refresh();
+
+    // Packs covers into one buffer: a 4-byte little-endian length, a JSON
+    // index of {id, offset, length, type} and then the concatenated images.
+    // Offsets are relative to the first byte after the index.
+    std::string buildBundle(const std::vector<std::string>& ids, const CoverRequest& request = CoverRequest()) const;
+
+    // Bundle of every cover, built once per version and request shape
+    std::shared_ptr<const std::string> fullBundle(const CoverRequest& request = CoverRequest());
+
+private:
+    struct CachedBundle {
+        std::uint64_t version;
+        std::shared_ptr<const std::string> bytes;
+    };
+
+    void refreshLoop();
+    static std::shared_ptr<const Cover> select(const CoverSet& set, const CoverRequest& request);
+    static std::string packBundle(const CoverMap& source, const std::vector<std::string>& ids,
+        const CoverRequest& request, std::uint64_t version);
+
+    const std::string coversPath;
+    const std::chrono::seconds refreshInterval;
+
+    std::shared_ptr<const CoverMap> covers;
+    std::atomic<std::uint64_t> currentVersion{ 0 };
+
+    std::mutex refreshMutex;
+
+    std::mutex bundleMutex;
+    std::unordered_map<std::string, CachedBundle> bundles;
+
+    std::mutex stopMutex;
+    std::condition_variable stopCondition;
+    bool stopping = false;
+    std::thread refresher;
+};
+
+#endif // COVERSTORE_H
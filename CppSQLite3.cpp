@@ -348,8 +348,24 @@ void CppSQLite3Binary::clear()
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Maps every column of pVM to its index; the first of duplicate names wins,
+// as the linear scan it replaces did
+static std::shared_ptr<const CppSQLite3FieldMap> buildFieldMap(sqlite3_stmt* pVM)
+{
+    auto pFields = std::make_shared<CppSQLite3FieldMap>();
+    int nCols = sqlite3_column_count(pVM);
+    pFields->reserve(nCols);
+    for (int nField = 0; nField < nCols; nField++)
+    {
+        pFields->emplace(sqlite3_column_name(pVM, nField), nField);
+    }
+    return pFields;
+}
+
+
 CppSQLite3Query::CppSQLite3Query()
 {
+    mpDB = 0;
     mpVM = 0;
     mbEof = true;
     mnCols = 0;
@@ -357,57 +373,56 @@ CppSQLite3Query::CppSQLite3Query()
 }
 
 
-CppSQLite3Query::CppSQLite3Query(const CppSQLite3Query& rQuery)
+CppSQLite3Query::CppSQLite3Query(CppSQLite3Query&& rQuery) noexcept
 {
+    mpDB = rQuery.mpDB;
     mpVM = rQuery.mpVM;
     // Only one object can own the VM
-    const_cast<CppSQLite3Query&>(rQuery).mpVM = 0;
+    rQuery.mpVM = 0;
     mbEof = rQuery.mbEof;
     mnCols = rQuery.mnCols;
     mbOwnVM = rQuery.mbOwnVM;
+    mpFields = std::move(rQuery.mpFields);
 }
 
 
 CppSQLite3Query::CppSQLite3Query(sqlite3* pDB,
     sqlite3_stmt* pVM,
     bool bEof,
-    bool bOwnVM/*=true*/)
+    bool bOwnVM/*=true*/,
+    std::shared_ptr<const CppSQLite3FieldMap> pFields/*=nullptr*/)
 {
     mpDB = pDB;
     mpVM = pVM;
     mbEof = bEof;
     mnCols = sqlite3_column_count(mpVM);
     mbOwnVM = bOwnVM;
+    mpFields = std::move(pFields);
 }
 
 
 CppSQLite3Query::~CppSQLite3Query()
 {
-    try
-    {
-        finalize();
-    }
-    catch (...)
-    {
-    }
+    release();
 }
 
 
-CppSQLite3Query& CppSQLite3Query::operator=(const CppSQLite3Query& rQuery)
+CppSQLite3Query& CppSQLite3Query::operator=(CppSQLite3Query&& rQuery) noexcept
 {
-    try
-    {
-        finalize();
-    }
-    catch (...)
+    if (this == &rQuery)
     {
+        return *this;
     }
+
+    release();
+    mpDB = rQuery.mpDB;
     mpVM = rQuery.mpVM;
     // Only one object can own the VM
-    const_cast<CppSQLite3Query&>(rQuery).mpVM = 0;
+    rQuery.mpVM = 0;
     mbEof = rQuery.mbEof;
     mnCols = rQuery.mnCols;
     mbOwnVM = rQuery.mbOwnVM;
+    mpFields = std::move(rQuery.mpFields);
     return *this;
 }
 
@@ -564,6 +579,48 @@ const unsigned char* CppSQLite3Query::getBlobField(const char* szField, int& nLe
 }
 
 
+std::string_view CppSQLite3Query::getStringView(int nField) const
+{
+    if (fieldDataType(nField) == SQLITE_NULL)
+    {
+        return std::string_view();
+    }
+
+    // Text first, then bytes: the length refers to the converted value
+    const char* szText = (const char*)sqlite3_column_text(mpVM, nField);
+    return std::string_view(szText, sqlite3_column_bytes(mpVM, nField));
+}
+
+
+std::string_view CppSQLite3Query::getStringView(const char* szField) const
+{
+    int nField = fieldIndex(szField);
+    return getStringView(nField);
+}
+
+
+CppSQLite3BlobView CppSQLite3Query::getBlobView(int nField) const
+{
+    int nLen = 0;
+    const unsigned char* pData = getBlobField(nField, nLen);
+
+    CppSQLite3BlobView view;
+    if (pData)
+    {
+        view.data = reinterpret_cast<const std::byte*>(pData);
+        view.size = static_cast<size_t>(nLen);
+    }
+    return view;
+}
+
+
+CppSQLite3BlobView CppSQLite3Query::getBlobView(const char* szField) const
+{
+    int nField = fieldIndex(szField);
+    return getBlobView(nField);
+}
+
+
 bool CppSQLite3Query::fieldIsNull(int nField) const
 {
     return (fieldDataType(nField) == SQLITE_NULL);
@@ -583,14 +640,15 @@ int CppSQLite3Query::fieldIndex(const char* szField) const
 
     if (szField)
     {
-        for (int nField = 0; nField < mnCols; nField++)
+        if (!mpFields)
         {
-            const char* szTemp = sqlite3_column_name(mpVM, nField);
+            mpFields = buildFieldMap(mpVM);
+        }
 
-            if (strcmp(szField, szTemp) == 0)
-            {
-                return nField;
-            }
+        auto it = mpFields->find(szField);
+        if (it != mpFields->end())
+        {
+            return it->second;
         }
     }
 
@@ -679,6 +737,18 @@ void CppSQLite3Query::nextRow()
 }
 
 
+void CppSQLite3Query::release() noexcept
+{
+    // sqlite3_finalize only repeats the last step's error, which the caller
+    // has already seen; nothing here can fail
+    if (mpVM && mbOwnVM)
+    {
+        sqlite3_finalize(mpVM);
+    }
+    mpVM = 0;
+}
+
+
 void CppSQLite3Query::finalize()
 {
     if (mpVM && mbOwnVM)
@@ -994,15 +1064,18 @@ CppSQLite3Statement::CppSQLite3Statement()
 {
     mpDB = 0;
     mpVM = 0;
+    mnFieldPrepares = 0;
 }
 
 
-CppSQLite3Statement::CppSQLite3Statement(const CppSQLite3Statement& rStatement)
+CppSQLite3Statement::CppSQLite3Statement(CppSQLite3Statement&& rStatement) noexcept
 {
     mpDB = rStatement.mpDB;
     mpVM = rStatement.mpVM;
+    mpFields = std::move(rStatement.mpFields);
+    mnFieldPrepares = rStatement.mnFieldPrepares;
     // Only one object can own VM
-    const_cast<CppSQLite3Statement&>(rStatement).mpVM = 0;
+    rStatement.mpVM = 0;
 }
 
 
@@ -1010,27 +1083,31 @@ CppSQLite3Statement::CppSQLite3Statement(sqlite3* pDB, sqlite3_stmt* pVM)
 {
     mpDB = pDB;
     mpVM = pVM;
+    mnFieldPrepares = 0;
 }
 
 
 CppSQLite3Statement::~CppSQLite3Statement()
 {
-    try
-    {
-        finalize();
-    }
-    catch (...)
-    {
-    }
+    release();
 }
 
 
-CppSQLite3Statement& CppSQLite3Statement::operator=(const CppSQLite3Statement& rStatement)
+CppSQLite3Statement& CppSQLite3Statement::operator=(CppSQLite3Statement&& rStatement) noexcept
 {
+    if (this == &rStatement)
+    {
+        return *this;
+    }
+
+    // The statement being replaced is finalized, not leaked
+    release();
     mpDB = rStatement.mpDB;
     mpVM = rStatement.mpVM;
+    mpFields = std::move(rStatement.mpFields);
+    mnFieldPrepares = rStatement.mnFieldPrepares;
     // Only one object can own VM
-    const_cast<CppSQLite3Statement&>(rStatement).mpVM = 0;
+    rStatement.mpVM = 0;
     return *this;
 }
 
@@ -1074,15 +1151,28 @@ CppSQLite3Query CppSQLite3Statement::execQuery()
 
     int nRet = sqlite3_step(mpVM);
 
+    // Stepping may re-prepare the statement after a schema change, which can
+    // rename or reorder columns without changing their count, so the map is
+    // rebuilt whenever SQLite reports a new re-prepare
+    if (nRet == SQLITE_DONE || nRet == SQLITE_ROW)
+    {
+        int nPrepares = sqlite3_stmt_status(mpVM, SQLITE_STMTSTATUS_REPREPARE, 0);
+        if (!mpFields || mnFieldPrepares != nPrepares)
+        {
+            mpFields = buildFieldMap(mpVM);
+            mnFieldPrepares = nPrepares;
+        }
+    }
+
     if (nRet == SQLITE_DONE)
     {
         // no rows
-        return CppSQLite3Query(mpDB, mpVM, true/*eof*/, false);
+        return CppSQLite3Query(mpDB, mpVM, true/*eof*/, false, mpFields);
     }
     else if (nRet == SQLITE_ROW)
     {
         // at least 1 row
-        return CppSQLite3Query(mpDB, mpVM, false/*eof*/, false);
+        return CppSQLite3Query(mpDB, mpVM, false/*eof*/, false, mpFields);
     }
     else
     {
@@ -1193,6 +1283,25 @@ void CppSQLite3Statement::reset()
 }
 
 
+void CppSQLite3Statement::clearBindings()
+{
+    if (mpVM)
+    {
+        sqlite3_clear_bindings(mpVM);
+    }
+}
+
+
+void CppSQLite3Statement::release() noexcept
+{
+    if (mpVM)
+    {
+        sqlite3_finalize(mpVM);
+        mpVM = 0;
+    }
+}
+
+
 void CppSQLite3Statement::finalize()
 {
     if (mpVM)
@@ -1263,7 +1372,13 @@ CppSQLite3DB& CppSQLite3DB::operator=(const CppSQLite3DB& db)
 
 void CppSQLite3DB::open(const char* szFile)
 {
-    int nRet = sqlite3_open(szFile, &mpDB);
+    open(szFile, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+}
+
+
+void CppSQLite3DB::open(const char* szFile, int nFlags)
+{
+    int nRet = sqlite3_open_v2(szFile, &mpDB, nFlags, 0);
 
     if (nRet != SQLITE_OK)
     {
@@ -1401,6 +1516,95 @@ void CppSQLite3DB::setBusyTimeout(int nMillisecs)
 }
 
 
+void CppSQLite3DB::setWalHook(int (*xCallback)(void*, sqlite3*, const char*, int), void* pArg)
+{
+    checkDB();
+    sqlite3_wal_hook(mpDB, xCallback, pArg);
+}
+
+
+void CppSQLite3DB::walCheckpoint(int nMode, int& nLogFrames, int& nCheckpointed)
+{
+    checkDB();
+
+    int nRet = sqlite3_wal_checkpoint_v2(mpDB, 0, nMode, &nLogFrames, &nCheckpointed);
+
+    if (nRet != SQLITE_OK)
+    {
+        const char* szError = sqlite3_errmsg(mpDB);
+        throw CppSQLite3Exception(nRet, (char*)szError, DONT_DELETE_MSG);
+    }
+}
+
+
+void CppSQLite3DB::backupFrom(CppSQLite3DB& source)
+{
+    checkDB();
+    source.checkDB();
+
+    sqlite3_backup* pBackup = sqlite3_backup_init(mpDB, "main", source.mpDB, "main");
+
+    if (!pBackup)
+    {
+        const char* szError = sqlite3_errmsg(mpDB);
+        throw CppSQLite3Exception(sqlite3_errcode(mpDB), (char*)szError, DONT_DELETE_MSG);
+    }
+
+    // finish() reports BUSY and LOCKED as success, so a copy cut short by a
+    // lock would pass unnoticed; only DONE means every page was copied
+    int nStep = sqlite3_backup_step(pBackup, -1);
+    if (nStep != SQLITE_DONE)
+    {
+        sqlite3_backup_finish(pBackup);
+        throw CppSQLite3Exception(nStep, (char*)sqlite3_errstr(nStep), DONT_DELETE_MSG);
+    }
+
+    int nRet = sqlite3_backup_finish(pBackup);
+
+    if (nRet != SQLITE_OK)
+    {
+        const char* szError = sqlite3_errmsg(mpDB);
+        throw CppSQLite3Exception(nRet, (char*)szError, DONT_DELETE_MSG);
+    }
+}
+
+
+std::string CppSQLite3DB::serialize()
+{
+    checkDB();
+
+    sqlite3_int64 nSize = 0;
+    unsigned char* pData = sqlite3_serialize(mpDB, "main", &nSize, 0);
+
+    if (!pData)
+    {
+        throw CppSQLite3Exception(SQLITE_NOMEM, "Unable to serialize database", DONT_DELETE_MSG);
+    }
+
+    std::string image(reinterpret_cast<const char*>(pData), static_cast<size_t>(nSize));
+    sqlite3_free(pData);
+    return image;
+}
+
+
+void CppSQLite3DB::deserializeInPlace(const std::string& image)
+{
+    checkDB();
+
+    // Without FREEONCLOSE SQLite never frees or resizes the buffer, and
+    // READONLY keeps it from writing to it
+    unsigned char* pData = reinterpret_cast<unsigned char*>(const_cast<char*>(image.data()));
+    int nRet = sqlite3_deserialize(mpDB, "main", pData, image.size(), image.size(),
+        SQLITE_DESERIALIZE_READONLY);
+
+    if (nRet != SQLITE_OK)
+    {
+        const char* szError = sqlite3_errmsg(mpDB);
+        throw CppSQLite3Exception(nRet, (char*)szError, DONT_DELETE_MSG);
+    }
+}
+
+
 void CppSQLite3DB::checkDB() const
 {
     if (!mpDB)
@@ -1420,7 +1624,8 @@ sqlite3_stmt* CppSQLite3DB::compile(const char* szSQL)
     const char* szTail = 0;
     sqlite3_stmt* pVM;
 
-    int nRet = sqlite3_prepare(mpDB, szSQL, -1, &pVM, &szTail);
+    // _v2 re-prepares on schema changes, which long-lived cached statements need
+    int nRet = sqlite3_prepare_v2(mpDB, szSQL, -1, &pVM, &szTail);
 
     if (nRet != SQLITE_OK)
     {
@@ -9,12 +9,32 @@
 #define CppSQLite3_H
 
 #include <sqlite3.h>
+#include <cstddef>
 #include <cstdio>
 #include <cstring>
 #include <exception>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 
 #define CPPSQLITE_ERROR 1000
 
+// Column name -> index for one prepared statement, built once and shared by
+// every query run on it
+typedef std::unordered_map<std::string, int> CppSQLite3FieldMap;
+
+// Read-only view of a BLOB column (std::span is C++20)
+struct CppSQLite3BlobView
+{
+    const std::byte* data = nullptr;
+    size_t size = 0;
+
+    bool empty() const { return size == 0; }
+    const std::byte* begin() const { return data; }
+    const std::byte* end() const { return data + size; }
+};
+
 namespace detail
 {
     /**
@@ -138,14 +158,18 @@ public:
 
     CppSQLite3Query();
 
-    CppSQLite3Query(const CppSQLite3Query& rQuery);
+    // Move-only: exactly one object owns (or resets) the VM
+    CppSQLite3Query(CppSQLite3Query&& rQuery) noexcept;
+    CppSQLite3Query(const CppSQLite3Query&) = delete;
 
     CppSQLite3Query(sqlite3* pDB,
         sqlite3_stmt* pVM,
         bool bEof,
-        bool bOwnVM = true);
+        bool bOwnVM = true,
+        std::shared_ptr<const CppSQLite3FieldMap> pFields = nullptr);
 
-    CppSQLite3Query& operator=(const CppSQLite3Query& rQuery);
+    CppSQLite3Query& operator=(CppSQLite3Query&& rQuery) noexcept;
+    CppSQLite3Query& operator=(const CppSQLite3Query&) = delete;
 
     virtual ~CppSQLite3Query();
 
@@ -178,6 +202,13 @@ public:
     const unsigned char* getBlobField(int nField, int& nLen) const;
     const unsigned char* getBlobField(const char* szField, int& nLen) const;
 
+    // Views into SQLite's own buffers: no copy, no strlen, valid until
+    // nextRow() or the query goes away. NULL reads as an empty view.
+    std::string_view getStringView(int nField) const;
+    std::string_view getStringView(const char* szField) const;
+    CppSQLite3BlobView getBlobView(int nField) const;
+    CppSQLite3BlobView getBlobView(const char* szField) const;
+
     bool fieldIsNull(int nField) const;
     bool fieldIsNull(const char* szField) const;
 
@@ -190,12 +221,15 @@ public:
 private:
 
     void checkVM() const;
+    void release() noexcept;
 
     sqlite3* mpDB;
     sqlite3_stmt* mpVM;
     bool mbEof;
     int mnCols;
     bool mbOwnVM;
+    // Built on the first by-name lookup unless the statement supplied one
+    mutable std::shared_ptr<const CppSQLite3FieldMap> mpFields;
 };
 
 
@@ -258,13 +292,16 @@ public:
 
     CppSQLite3Statement();
 
-    CppSQLite3Statement(const CppSQLite3Statement& rStatement);
+    // Move-only: exactly one object owns and finalizes the statement
+    CppSQLite3Statement(CppSQLite3Statement&& rStatement) noexcept;
+    CppSQLite3Statement(const CppSQLite3Statement&) = delete;
 
     CppSQLite3Statement(sqlite3* pDB, sqlite3_stmt* pVM);
 
     virtual ~CppSQLite3Statement();
 
-    CppSQLite3Statement& operator=(const CppSQLite3Statement& rStatement);
+    CppSQLite3Statement& operator=(CppSQLite3Statement&& rStatement) noexcept;
+    CppSQLite3Statement& operator=(const CppSQLite3Statement&) = delete;
 
     int execDML();
 
@@ -279,15 +316,20 @@ public:
 
     void reset();
 
+    void clearBindings();
+
     void finalize();
 
 private:
 
     void checkDB() const;
     void checkVM() const;
+    void release() noexcept;
 
     sqlite3* mpDB;
     sqlite3_stmt* mpVM;
+    std::shared_ptr<const CppSQLite3FieldMap> mpFields;
+    int mnFieldPrepares;    // Re-prepare count mpFields was built at
 };
 
 
@@ -301,6 +343,9 @@ public:
 
     void open(const char* szFile);
 
+    // sqlite3_open_v2 flags, e.g. SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX
+    void open(const char* szFile, int nFlags);
+
     void close();
 
     bool tableExists(const char* szTable);
@@ -321,6 +366,24 @@ public:
 
     void setBusyTimeout(int nMillisecs);
 
+    // Called after every commit with the number of frames in the WAL
+    void setWalHook(int (*xCallback)(void*, sqlite3*, const char*, int), void* pArg);
+
+    // sqlite3_wal_checkpoint_v2 on the main database; returns the frames in
+    // the WAL and how many of them are now in the database file
+    void walCheckpoint(int nMode, int& nLogFrames, int& nCheckpointed);
+
+    // Copies every page of source's main database over this one with the
+    // online backup API, in a single step
+    void backupFrom(CppSQLite3DB& source);
+
+    // The main database as the bytes of a database file, and back.
+    // deserializeInPlace opens the image read-only without copying it, so
+    // many connections can share one buffer; the caller keeps image alive
+    // until this connection closes or loads another one.
+    std::string serialize();
+    void deserializeInPlace(const std::string& image);
+
     static const char* SQLiteVersion() { return SQLITE_VERSION; }
 
 private:
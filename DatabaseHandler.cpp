@@ -1,5 +1,10 @@
 #include "DatabaseHandler.h"
+#include "RowMapping.h"
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <stdexcept>
 #include <fstream>
 #include <nlohmann/json.hpp>
@@ -7,24 +12,255 @@ using json = nlohmann::json;
 #include <filesystem>
 namespace fs = std::filesystem;
 
-
-DatabaseHandler::DatabaseHandler(const std::string& dbPath) {
+template <> struct RowMapping<MediaRecord> {
+    static constexpr auto columns = std::make_tuple(
+        column("ID", &MediaRecord::id),
+        column("title", &MediaRecord::title),
+        column("year", &MediaRecord::year),
+        column("description", &MediaRecord::description),
+        column("producer", &MediaRecord::producer),
+        column("rating", &MediaRecord::rating),
+        column("season", &MediaRecord::season),
+        column("episode", &MediaRecord::episode),
+        column("resolution", &MediaRecord::resolution),
+        column("image_path", &MediaRecord::imagePath),
+        column("genres", &MediaRecord::genres),
+        column("type", &MediaRecord::type),
+        column("collection_id", &MediaRecord::collectionID));
+};
+
+template <> struct RowMapping<CollectionRecord> {
+    static constexpr auto columns = std::make_tuple(
+        column("ID", &CollectionRecord::id),
+        column("collection_title", &CollectionRecord::title),
+        column("collection_description", &CollectionRecord::description),
+        column("collection_rating", &CollectionRecord::rating),
+        column("collection_type", &CollectionRecord::type),
+        column("genres", &CollectionRecord::genres),
+        column("producer", &CollectionRecord::producer),
+        column("image_path", &CollectionRecord::imagePath));
+};
+
+template <> struct RowMapping<ProfileRecord> {
+    static constexpr auto columns = std::make_tuple(
+        column("userID", &ProfileRecord::userID),
+        column("profileID", &ProfileRecord::profileID),
+        column("pictureID", &ProfileRecord::pictureID));
+};
+
+template <> struct RowMapping<MediaProgress> {
+    static constexpr auto columns = std::make_tuple(
+        column("userID", &MediaProgress::userID),
+        column("profileID", &MediaProgress::profileID),
+        column("mediaID", &MediaProgress::mediaID),
+        column("percentage_watched", &MediaProgress::percentageWatched),
+        column("language_chosen", &MediaProgress::languageChosen),
+        column("subtitles_chosen", &MediaProgress::subtitlesChosen));
+};
+
+template <> struct RowMapping<EpisodeRow> {
+    static constexpr auto columns = std::make_tuple(
+        column("ID", &EpisodeRow::mediaID),
+        column("collection_id", &EpisodeRow::collectionID),
+        column("season", &EpisodeRow::season),
+        column("episode", &EpisodeRow::episode));
+};
+
+
+DatabaseHandler::DatabaseHandler(const std::string& dbPath, size_t readers, const DatabaseOptions& options) {
     try {
-        db.open(dbPath.c_str());
+        // The background checkpointer replaces SQLite's own, which would run
+        // inside whichever commit crosses the threshold
+        PragmaProfile pragmas = options.pragmas;
+        pragmas.autoCheckpoint = false;
+        pool = std::make_unique<ConnectionPool>(dbPath, readers, pragmas);
+
+        if (pool->journalMode() == "wal") {
+            checkpointer = std::make_unique<WalCheckpointer>(dbPath, options.checkpoints, pragmas);
+            pool->writer()->setWalHook(&WalCheckpointer::onCommit, checkpointer.get());
+        }
     }
     catch (const CppSQLite3Exception& e) {
         throw std::runtime_error("Failed to open database: " + std::string(e.errorMessage()));
     }
+
+    try {
+        migrate();
+    }
+    catch (const CppSQLite3Exception& e) {
+        throw std::runtime_error("Failed to migrate database: " + std::string(e.errorMessage()));
+    }
+
+    writes = std::make_unique<GroupCommitter>(*pool, options.groupCommit);
+    executor = std::make_unique<DbExecutor>(pool->readerCount(), options.executorQueue);
+}
+
+namespace {
+
+    // Schema changes the server owns, applied in order on startup. A
+    // database records the last one it got in PRAGMA user_version; never
+    // edit a released step, append a new one instead.
+    struct Migration {
+        int version;
+        const char* description;
+        const char* sql;
+    };
+
+    const Migration migrations[] = {
+        // Every Collection/Media row change gets a monotonic version. The ingest
+        // scripts write through their own connections, so this has to live in
+        // triggers rather than in the server code. IF NOT EXISTS because servers
+        // before user_version created it unconditionally.
+        { 1, "catalog change log", R"(
+        CREATE TABLE IF NOT EXISTS CatalogChange (
+            version INTEGER PRIMARY KEY AUTOINCREMENT,
+            tableName TEXT NOT NULL,
+            rowID TEXT NOT NULL,
+            op TEXT CHECK(op IN ('upsert', 'delete')) NOT NULL
+        );
+
+        CREATE TRIGGER IF NOT EXISTS Media_change_insert AFTER INSERT ON Media BEGIN
+            INSERT INTO CatalogChange (tableName, rowID, op) VALUES ('Media', NEW.ID, 'upsert');
+        END;
+        CREATE TRIGGER IF NOT EXISTS Media_change_update AFTER UPDATE ON Media BEGIN
+            INSERT INTO CatalogChange (tableName, rowID, op) SELECT 'Media', OLD.ID, 'delete' WHERE OLD.ID IS NOT NEW.ID;
+            INSERT INTO CatalogChange (tableName, rowID, op) VALUES ('Media', NEW.ID, 'upsert');
+        END;
+        CREATE TRIGGER IF NOT EXISTS Media_change_delete AFTER DELETE ON Media BEGIN
+            INSERT INTO CatalogChange (tableName, rowID, op) VALUES ('Media', OLD.ID, 'delete');
+        END;
+
+        CREATE TRIGGER IF NOT EXISTS Collection_change_insert AFTER INSERT ON Collection BEGIN
+            INSERT INTO CatalogChange (tableName, rowID, op) VALUES ('Collection', NEW.ID, 'upsert');
+        END;
+        CREATE TRIGGER IF NOT EXISTS Collection_change_update AFTER UPDATE ON Collection BEGIN
+            INSERT INTO CatalogChange (tableName, rowID, op) SELECT 'Collection', OLD.ID, 'delete' WHERE OLD.ID IS NOT NEW.ID;
+            INSERT INTO CatalogChange (tableName, rowID, op) VALUES ('Collection', NEW.ID, 'upsert');
+        END;
+        CREATE TRIGGER IF NOT EXISTS Collection_change_delete AFTER DELETE ON Collection BEGIN
+            INSERT INTO CatalogChange (tableName, rowID, op) VALUES ('Collection', OLD.ID, 'delete');
+        END;
+    )" },
+
+        // Next-episode lookups and collection listings walk a collection in
+        // (season, episode) order; titles and per-media progress are looked up
+        // directly
+        { 2, "indexes for hot queries", R"(
+        CREATE INDEX IF NOT EXISTS Media_episode_order ON Media (collection_id, season, episode);
+        CREATE INDEX IF NOT EXISTS Media_title ON Media (title);
+        CREATE INDEX IF NOT EXISTS mediaMetadata_media ON mediaMetadata (mediaID);
+    )" },
+
+        // The genres columns stay as JSON text for the catalog payload; these
+        // tables make "everything in a genre" an index seek. Triggers keep them
+        // in sync with the ingest scripts, which INSERT OR REPLACE (a REPLACE
+        // does not fire the delete trigger, so inserts clear old rows first).
+        { 3, "genre join tables", R"(
+        CREATE TABLE MediaGenre (
+            genre TEXT NOT NULL,
+            mediaID TEXT NOT NULL,
+            PRIMARY KEY (genre, mediaID)
+        ) WITHOUT ROWID;
+        CREATE INDEX MediaGenre_media ON MediaGenre (mediaID);
+
+        CREATE TABLE CollectionGenre (
+            genre TEXT NOT NULL,
+            collectionID TEXT NOT NULL,
+            PRIMARY KEY (genre, collectionID)
+        ) WITHOUT ROWID;
+        CREATE INDEX CollectionGenre_collection ON CollectionGenre (collectionID);
+
+        INSERT OR IGNORE INTO MediaGenre (genre, mediaID)
+            SELECT g.value, Media.ID FROM Media,
+                json_each(CASE WHEN json_valid(Media.genres) THEN Media.genres ELSE '[]' END) AS g
+            WHERE g.type = 'text' AND g.value <> '';
+        INSERT OR IGNORE INTO CollectionGenre (genre, collectionID)
+            SELECT g.value, Collection.ID FROM Collection,
+                json_each(CASE WHEN json_valid(Collection.genres) THEN Collection.genres ELSE '[]' END) AS g
+            WHERE g.type = 'text' AND g.value <> '';
+
+        CREATE TRIGGER Media_genre_insert AFTER INSERT ON Media BEGIN
+            DELETE FROM MediaGenre WHERE mediaID = NEW.ID;
+            INSERT OR IGNORE INTO MediaGenre (genre, mediaID)
+                SELECT value, NEW.ID FROM json_each(CASE WHEN json_valid(NEW.genres) THEN NEW.genres ELSE '[]' END)
+                WHERE type = 'text' AND value <> '';
+        END;
+        CREATE TRIGGER Media_genre_update AFTER UPDATE OF ID, genres ON Media BEGIN
+            DELETE FROM MediaGenre WHERE mediaID = OLD.ID;
+            INSERT OR IGNORE INTO MediaGenre (genre, mediaID)
+                SELECT value, NEW.ID FROM json_each(CASE WHEN json_valid(NEW.genres) THEN NEW.genres ELSE '[]' END)
+                WHERE type = 'text' AND value <> '';
+        END;
+        CREATE TRIGGER Media_genre_delete AFTER DELETE ON Media BEGIN
+            DELETE FROM MediaGenre WHERE mediaID = OLD.ID;
+        END;
+
+        CREATE TRIGGER Collection_genre_insert AFTER INSERT ON Collection BEGIN
+            DELETE FROM CollectionGenre WHERE collectionID = NEW.ID;
+            INSERT OR IGNORE INTO CollectionGenre (genre, collectionID)
+                SELECT value, NEW.ID FROM json_each(CASE WHEN json_valid(NEW.genres) THEN NEW.genres ELSE '[]' END)
+                WHERE type = 'text' AND value <> '';
+        END;
+        CREATE TRIGGER Collection_genre_update AFTER UPDATE OF ID, genres ON Collection BEGIN
+            DELETE FROM CollectionGenre WHERE collectionID = OLD.ID;
+            INSERT OR IGNORE INTO CollectionGenre (genre, collectionID)
+                SELECT value, NEW.ID FROM json_each(CASE WHEN json_valid(NEW.genres) THEN NEW.genres ELSE '[]' END)
+                WHERE type = 'text' AND value <> '';
+        END;
+        CREATE TRIGGER Collection_genre_delete AFTER DELETE ON Collection BEGIN
+            DELETE FROM CollectionGenre WHERE collectionID = OLD.ID;
+        END;
+    )" },
+    };
+
+}
+
+void DatabaseHandler::migrate() {
+    auto db = pool->writer();
+
+    int current = db->execScalar("PRAGMA user_version;");
+    const Migration& latest = migrations[std::size(migrations) - 1];
+    if (current > latest.version) {
+        std::cerr << "Database schema version " << current << " is newer than this server ("
+            << latest.version << ")" << std::endl;
+        return;
+    }
+
+    for (const Migration& migration : migrations) {
+        if (migration.version <= current) {
+            continue;
+        }
+
+        // Each step and its version bump commit together
+        try {
+            db->execDML("BEGIN IMMEDIATE;");
+            db->execDML(migration.sql);
+            db->execDML(("PRAGMA user_version = " + std::to_string(migration.version) + ";").c_str());
+            db->execDML("COMMIT;");
+        }
+        catch (const CppSQLite3Exception& e) {
+            try {
+                db->execDML("ROLLBACK;");
+            }
+            catch (const CppSQLite3Exception&) {
+                // Already rolled back by the failing statement
+            }
+            throw std::runtime_error("Failed to migrate database to version " + std::to_string(migration.version) +
+                " (" + migration.description + "): " + std::string(e.errorMessage()));
+        }
+        std::cout << "Database migrated to version " << migration.version << ": " << migration.description << std::endl;
+    }
 }
 
 DatabaseHandler::~DatabaseHandler() {
-    db.close();
 }
 
 std::string DatabaseHandler::getPassword(const std::string& userID) {
+    auto db = pool->reader();
+
     try {
         // Query all profiles associated with the given userID
-        CppSQLite3Statement stmt = db.compileStatement("SELECT password FROM User WHERE ID = ?;");
+        CppSQLite3Statement& stmt = db.statement("SELECT password FROM User WHERE ID = ?;");
         stmt.bind(1, userID.c_str());
         CppSQLite3Query query = stmt.execQuery();
 
@@ -40,11 +276,27 @@ std::string DatabaseHandler::getPassword(const std::string& userID) {
     }
 }
 
+bool DatabaseHandler::profileExists(const std::string& userID, const std::string& profileID) {
+    auto db = pool->reader();
+
+    try {
+        CppSQLite3Statement& stmt = db.statement("SELECT 1 FROM Profile WHERE userID = ? AND profileID = ?;");
+        stmt.bind(1, userID.c_str());
+        stmt.bind(2, profileID.c_str());
+        return !stmt.execQuery().eof();
+    }
+    catch (const CppSQLite3Exception& e) {
+        throw std::runtime_error("Failed to look up profile: " + std::string(e.errorMessage()));
+    }
+}
+
 std::vector<std::pair<std::string, std::string>> DatabaseHandler::getAllUserPasswords() {
+    auto db = pool->reader();
+
     std::vector<std::pair<std::string, std::string>> passwords;
 
     try {
-        CppSQLite3Query query = db.execQuery("SELECT ID, password FROM User;");
+        CppSQLite3Query query = db.statement("SELECT ID, password FROM User;").execQuery();
         while (!query.eof()) {
             std::string userID = query.getStringField("ID");
             std::string password = query.getStringField("password");
@@ -63,13 +315,15 @@ std::vector<std::pair<std::string, std::string>> DatabaseHandler::getAllUserPass
 
 bool DatabaseHandler::deleteProfile(const std::string& userID, const std::string& profileID) {
     try {
-        // Delete profile from Profile table based on both userID and profileID
-        CppSQLite3Statement stmt = db.compileStatement("DELETE FROM Profile WHERE userID = ? AND profileID = ?;");
-        stmt.bind(1, userID.c_str());
-        stmt.bind(2, profileID.c_str());
-        int rowsAffected = stmt.execDML();
-
-        return rowsAffected > 0;  // True if a row was deleted
+        return writes->submit([&](ConnectionPool::Lease& db) {
+            // Delete profile from Profile table based on both userID and profileID
+            CppSQLite3Statement& stmt = db.statement("DELETE FROM Profile WHERE userID = ? AND profileID = ?;");
+            stmt.bind(1, userID.c_str());
+            stmt.bind(2, profileID.c_str());
+            int rowsAffected = stmt.execDML();
+
+            return rowsAffected > 0;  // True if a row was deleted
+            }).get();
     }
     catch (const CppSQLite3Exception& e) {
         std::cerr << "Failed to delete profile: " << e.errorMessage() << std::endl;
@@ -78,20 +332,15 @@ bool DatabaseHandler::deleteProfile(const std::string& userID, const std::string
 }
 
 
-void DatabaseHandler::getProfiles(const std::string& userID, std::vector<std::pair<std::string, std::string>>& profiles) {
+std::vector<ProfileRecord> DatabaseHandler::getProfiles(const std::string& userID) {
+    auto db = pool->reader();
+
+    static const std::string sql = "SELECT " + selectList<ProfileRecord>() + " FROM Profile WHERE userID = ?;";
     try {
-        // Query all profiles associated with the given userID
-        CppSQLite3Statement stmt = db.compileStatement("SELECT profileID, pictureID FROM Profile WHERE userID = ?;");
+        CppSQLite3Statement& stmt = db.statement(sql);
         stmt.bind(1, userID.c_str());
         CppSQLite3Query query = stmt.execQuery();
-
-        // Populate the profiles vector with pairs of profile ID and picture ID
-        while (!query.eof()) {
-            std::string profileID = query.getStringField("profileID");
-            std::string pictureID = query.getStringField("pictureID");
-            profiles.emplace_back(profileID, pictureID);
-            query.nextRow();
-        }
+        return readRows<ProfileRecord>(query);
     }
     catch (const CppSQLite3Exception& e) {
         throw std::runtime_error("Failed to fetch profiles: " + std::string(e.errorMessage()));
@@ -102,24 +351,26 @@ void DatabaseHandler::getProfiles(const std::string& userID, std::vector<std::pa
 
 bool DatabaseHandler::addProfile(const std::string& userID, const std::string& profileID, int pictureID) {
     try {
-        // Check if the user exists before adding a profile
-        CppSQLite3Statement userCheckStmt = db.compileStatement("SELECT COUNT(*) FROM User WHERE ID = ?;");
-        userCheckStmt.bind(1, userID.c_str());
-        CppSQLite3Query userCheckQuery = userCheckStmt.execQuery();
-
-        if (userCheckQuery.eof() || userCheckQuery.getIntField(0) == 0) {
-            std::cerr << "User does not exist with ID: " << userID << std::endl;
-            return false;
-        }
+        return writes->submit([&](ConnectionPool::Lease& db) {
+            // Check if the user exists before adding a profile
+            CppSQLite3Statement& userCheckStmt = db.statement("SELECT COUNT(*) FROM User WHERE ID = ?;");
+            userCheckStmt.bind(1, userID.c_str());
+            CppSQLite3Query userCheckQuery = userCheckStmt.execQuery();
+
+            if (userCheckQuery.eof() || userCheckQuery.getIntField(0) == 0) {
+                std::cerr << "User does not exist with ID: " << userID << std::endl;
+                return false;
+            }
 
-        // Insert profile into Profile table
-        CppSQLite3Statement stmt = db.compileStatement("INSERT INTO Profile (profileID, userID, pictureID) VALUES (?, ?, ?);");
-        stmt.bind(1, profileID.c_str());
-        stmt.bind(2, userID.c_str());
-        stmt.bind(3, pictureID);
-        stmt.execDML();
+            // Insert profile into Profile table
+            CppSQLite3Statement& stmt = db.statement("INSERT INTO Profile (profileID, userID, pictureID) VALUES (?, ?, ?);");
+            stmt.bind(1, profileID.c_str());
+            stmt.bind(2, userID.c_str());
+            stmt.bind(3, pictureID);
+            stmt.execDML();
 
-        return true;
+            return true;
+            }).get();
     }
     catch (const CppSQLite3Exception& e) {
         std::cerr << "Failed to add profile: " << e.errorMessage() << std::endl;
@@ -149,121 +400,87 @@ bool DatabaseHandler::addProfile(const std::string& userID, const std::string& p
 
 
 
-std::vector<std::string> DatabaseHandler::getAllCollections() {
-    std::vector<std::string> collections;
+std::vector<CollectionRecord> DatabaseHandler::getAllCollections() {
+    auto db = pool->replica();
+
+    static const std::string sql = "SELECT " + selectList<CollectionRecord>() + " FROM Collection;";
     try {
-        CppSQLite3Query query = db.execQuery("SELECT collection_title FROM Collection;");
-        while (!query.eof()) {
-            collections.push_back(query.getStringField("collection_title"));
-            query.nextRow();
-        }
+        CppSQLite3Query query = db.statement(sql).execQuery();
+        return readRows<CollectionRecord>(query);
     }
     catch (const CppSQLite3Exception& e) {
         throw std::runtime_error("Failed to fetch collections: " + std::string(e.errorMessage()));
     }
-    return collections;
 }
 
-std::string DatabaseHandler::getCollectionById(const std::string& collectionId) {
+std::optional<CollectionRecord> DatabaseHandler::getCollectionById(const std::string& collectionId) {
+    auto db = pool->replica();
+
+    static const std::string sql = "SELECT " + selectList<CollectionRecord>() + " FROM Collection WHERE ID = ?;";
     try {
-        CppSQLite3Statement stmt = db.compileStatement("SELECT collection_title FROM Collection WHERE ID = ?;");
+        CppSQLite3Statement& stmt = db.statement(sql);
         stmt.bind(1, collectionId.c_str());
         CppSQLite3Query query = stmt.execQuery();
 
-        if (!query.eof()) {
-            return query.getStringField("collection_title");
-        }
-        else {
-            throw std::runtime_error("Collection not found with ID: " + collectionId);
+        if (query.eof()) {
+            return std::nullopt;
         }
+        return readRow<CollectionRecord>(query);
     }
     catch (const CppSQLite3Exception& e) {
         throw std::runtime_error("Failed to fetch collection by ID: " + std::string(e.errorMessage()));
     }
 }
 
-std::vector<std::string> DatabaseHandler::getAllMediaIdsFromCollection(const std::string& collectionId) {
-    std::vector<std::string> mediaIds;
+std::vector<MediaRecord> DatabaseHandler::getMediaByCollection(const std::string& collectionId) {
+    auto db = pool->replica();
+
+    // Served by the Media_episode_order index
+    static const std::string sql = "SELECT " + selectList<MediaRecord>() +
+        " FROM Media WHERE collection_id = ? ORDER BY season, episode;";
     try {
-        CppSQLite3Statement stmt = db.compileStatement("SELECT medias FROM Collection WHERE ID = ?;");
+        CppSQLite3Statement& stmt = db.statement(sql);
         stmt.bind(1, collectionId.c_str());
         CppSQLite3Query query = stmt.execQuery();
-
-        if (!query.eof()) {
-            std::string mediaIdsJson = query.getStringField("medias");
-
-            // Parse JSON manually, assuming it's a comma-separated list within square brackets
-            std::string id;
-            for (char c : mediaIdsJson) {
-                if (c == ',' || c == ']' || c == '[') {
-                    if (!id.empty()) {
-                        mediaIds.push_back(id);
-                        id.clear();
-                    }
-                }
-                else if (c != ' ' && c != '"') {
-                    id += c;
-                }
-            }
-            if (!id.empty()) mediaIds.push_back(id);
-        }
-        else {
-            throw std::runtime_error("Collection not found with ID: " + collectionId);
-        }
+        return readRows<MediaRecord>(query);
     }
     catch (const CppSQLite3Exception& e) {
-        throw std::runtime_error("Failed to fetch media IDs from collection: " + std::string(e.errorMessage()));
+        throw std::runtime_error("Failed to fetch media from collection: " + std::string(e.errorMessage()));
     }
-    return mediaIds;
 }
 
-std::string DatabaseHandler::getMediaDataById(const std::string& mediaId) {
+std::optional<MediaRecord> DatabaseHandler::getMediaById(const std::string& mediaId) {
+    auto db = pool->replica();
+
+    static const std::string sql = "SELECT " + selectList<MediaRecord>() + " FROM Media WHERE ID = ?;";
     try {
-        CppSQLite3Statement stmt = db.compileStatement("SELECT title, description, producer, rating FROM Media WHERE ID = ?;");
+        CppSQLite3Statement& stmt = db.statement(sql);
         stmt.bind(1, mediaId.c_str());
         CppSQLite3Query query = stmt.execQuery();
 
-        if (!query.eof()) {
-            std::string title = query.getStringField("title");
-            std::string description = query.getStringField("description");
-            std::string producer = query.getStringField("producer");
-            double rating = query.getFloatField("rating");
-
-            return "Title: " + title + "\nDescription: " + description + "\nProducer: " + producer + "\nRating: " + std::to_string(rating);
-        }
-        else {
-            throw std::runtime_error("Media not found with ID: " + mediaId);
+        if (query.eof()) {
+            return std::nullopt;
         }
+        return readRow<MediaRecord>(query);
     }
     catch (const CppSQLite3Exception& e) {
         throw std::runtime_error("Failed to fetch media data by ID: " + std::string(e.errorMessage()));
     }
 }
 
-std::vector<std::string> DatabaseHandler::getAllMediaMetadataByMediaId(const std::string& mediaId) {
-    std::vector<std::string> metadataEntries;
+std::vector<MediaProgress> DatabaseHandler::getAllMediaMetadataByMediaId(const std::string& mediaId) {
+    auto db = pool->reader();
+
+    static const std::string sql = "SELECT " + selectList<MediaProgress>() + " FROM mediaMetadata WHERE mediaID = ?;";
     try {
-        CppSQLite3Statement stmt = db.compileStatement("SELECT * FROM mediaMetadata WHERE mediaID = ?;");
+        CppSQLite3Statement& stmt = db.statement(sql);
         stmt.bind(1, mediaId.c_str());
         CppSQLite3Query query = stmt.execQuery();
-
-        while (!query.eof()) {
-            std::string userId = query.getStringField("userID");
-            double percentageWatched = query.getFloatField("percentage_watched");
-            std::string language = query.getStringField("language_chosen");
-            std::string subtitles = query.getStringField("subtitles_chosen");
-
-            metadataEntries.push_back("User ID: " + userId +
-                ", Percentage Watched: " + std::to_string(percentageWatched) +
-                ", Language: " + language +
-                ", Subtitles: " + subtitles);
-            query.nextRow();
-        }
+        return readRows<MediaProgress>(query);
     }
     catch (const CppSQLite3Exception& e) {
         throw std::runtime_error("Failed to fetch media metadata by media ID: " + std::string(e.errorMessage()));
     }
-    return metadataEntries;
 }
 
 
@@ -271,102 +488,444 @@ std::vector<std::string> DatabaseHandler::getAllMediaMetadataByMediaId(const std
 
 
 std::vector<std::string> DatabaseHandler::getColumnNames(const std::string& tableName) {
-    std::vector<std::string> columnNames;
+    auto db = pool->reader();
+    return columnNames(db, tableName);
+}
 
-    // PRAGMA command to get table information
-    CppSQLite3Statement stmt = db.compileStatement(("PRAGMA table_info(" + tableName + ");").c_str());
-    CppSQLite3Query query = stmt.execQuery();
+std::vector<std::string> DatabaseHandler::columnNames(ConnectionPool::Lease& db, const std::string& tableName) {
+    std::vector<std::string> names;
 
-    while (!query.eof()) {
-        columnNames.push_back(query.getStringField("name"));  // "name" column contains the field names
-        query.nextRow();
+    // A prepared statement already knows its columns; LIMIT 0 never reads a row,
+    // and the cached statement is re-prepared if the table changes
+    CppSQLite3Query query = db.statement("SELECT * FROM \"" + tableName + "\" LIMIT 0;").execQuery();
+    for (int col = 0; col < query.numFields(); col++) {
+        names.push_back(query.fieldName(col));
     }
 
-    return columnNames;
+    return names;
 }
 
 
 
-void DatabaseHandler::generateMediaDataJson() {
-    json mediaDataJson;
+ConnectionPool::StatementStats DatabaseHandler::getStatementStats() const {
+    return pool->statementStats();
+}
+
+void DatabaseHandler::refreshReplica() {
+    try {
+        pool->refreshReplica();
+    }
+    catch (const CppSQLite3Exception& e) {
+        throw std::runtime_error("Failed to refresh catalog replica: " + std::string(e.errorMessage()));
+    }
+}
 
-    // Get column names for the Collection and Media tables
-    std::vector<std::string> collectionColumns = getColumnNames("Collection");
-    std::vector<std::string> mediaColumns = getColumnNames("Media");
+ConnectionPool::ReplicaStats DatabaseHandler::getReplicaStats() const {
+    return pool->replicaStats();
+}
 
-    // First get all collections
-    CppSQLite3Query collectionQuery = db.execQuery("SELECT * FROM Collection;");
-    json collectionsArray = json::array();
+GroupCommitStats DatabaseHandler::getWriteStats() const {
+    return writes->stats();
+}
 
-    while (!collectionQuery.eof()) {
-        json collectionJson;
+size_t DatabaseHandler::getQueuedTasks() const {
+    return executor->queued();
+}
 
-        // Populate JSON for collection row dynamically
-        for (const auto& col : collectionColumns) {
-            collectionJson[col] = collectionQuery.getStringField(col.c_str());
-        }
+const std::string& DatabaseHandler::getJournalMode() const {
+    return pool->journalMode();
+}
+
+CheckpointStats DatabaseHandler::getCheckpointStats() const {
+    return checkpointer ? checkpointer->stats() : CheckpointStats();
+}
+
+
+long long DatabaseHandler::getDataVersion() {
+    // Changes whenever another connection commits to the database. The value
+    // is per connection, so it is always read on the writer; the server's
+    // own writes (profiles, progress) then never look like catalog changes.
+    auto db = pool->writer();
+    CppSQLite3Query query = db.statement("PRAGMA data_version;").execQuery();
+    return query.getInt64Field(0);
+}
+
+
+long long DatabaseHandler::getCatalogVersion() {
+    auto db = pool->replica();
+
+    CppSQLite3Query query = db.statement("SELECT COALESCE(MAX(version), 0) FROM CatalogChange;").execQuery();
+    return query.getInt64Field(0);
+}
+
+
+long long DatabaseHandler::getOldestCatalogDelta() {
+    auto db = pool->replica();
 
-        collectionsArray.push_back(collectionJson);
-        collectionQuery.nextRow();
+    // Deltas can be computed from any version at or after the oldest kept entry - 1
+    CppSQLite3Query query = db.statement("SELECT MIN(version) - 1, MAX(version) FROM CatalogChange;").execQuery();
+    if (query.fieldIsNull(0)) {
+        return query.fieldIsNull(1) ? 0 : query.getInt64Field(1);
     }
+    return query.getInt64Field(0);
+}
+
+
+void DatabaseHandler::pruneCatalogChanges(long long keep) {
+    writes->submit([&](ConnectionPool::Lease& db) {
+        CppSQLite3Statement& stmt = db.statement(
+            "DELETE FROM CatalogChange WHERE version <= (SELECT MAX(version) FROM CatalogChange) - ?;");
+        stmt.bind(1, keep);
+        return stmt.execDML();
+        }).get();
+}
+
 
-    // Add collections array to main JSON
-    mediaDataJson["collections"] = collectionsArray;
+std::string DatabaseHandler::serializeMediaDataSince(long long since, long long version) {
+    auto db = pool->replica();
 
-    // Now get ALL media items
-    CppSQLite3Query mediaQuery = db.execQuery("SELECT * FROM Media;");
-    json mediaArray = json::array();
+    json delta;
+    delta["since"] = since;
+    delta["version"] = version;
 
-    while (!mediaQuery.eof()) {
-        json mediaJson;
+    // Rows touched after `since` that still exist are sent whole, the rest as deletions
+    auto changedRows = [&db, since, version](const std::string& table) {
+        json rows = json::array();
+        CppSQLite3Statement& stmt = db.statement("SELECT * FROM " + table +
+            " WHERE ID IN (SELECT rowID FROM CatalogChange WHERE tableName = ? AND version > ? AND version <= ?);");
+        stmt.bind(1, table.c_str());
+        stmt.bind(2, since);
+        stmt.bind(3, version);
+        CppSQLite3Query query = stmt.execQuery();
 
-        // Populate JSON for media row dynamically
-        for (const auto& col : mediaColumns) {
-            mediaJson[col] = mediaQuery.getStringField(col.c_str());
+        int columns = query.numFields();
+        std::vector<std::string> names;
+        for (int col = 0; col < columns; col++) {
+            names.push_back(query.fieldName(col));
         }
 
-        mediaArray.push_back(mediaJson);
-        mediaQuery.nextRow();
-    }
+        while (!query.eof()) {
+            json row;
+            for (int col = 0; col < columns; col++) {
+                row[names[col]] = std::string(query.getStringView(col));
+            }
+            rows.push_back(std::move(row));
+            query.nextRow();
+        }
+        return rows;
+    };
+
+    auto deletedRows = [&db, since, version](const std::string& table) {
+        json ids = json::array();
+        CppSQLite3Statement& stmt = db.statement("SELECT DISTINCT rowID FROM CatalogChange"
+            " WHERE tableName = ? AND version > ? AND version <= ? AND rowID NOT IN (SELECT ID FROM " + table + ");");
+        stmt.bind(1, table.c_str());
+        stmt.bind(2, since);
+        stmt.bind(3, version);
+        CppSQLite3Query query = stmt.execQuery();
 
-    // Add media array to main JSON
-    mediaDataJson["media"] = mediaArray;
+        while (!query.eof()) {
+            ids.push_back(query.getStringField(0));
+            query.nextRow();
+        }
+        return ids;
+    };
 
-    // Write the generated JSON to file
-    std::ofstream file("media_data.json");
-    file << mediaDataJson.dump(4);  // pretty-print with 4-space indentation
-    file.close();
+    delta["collections"] = changedRows("Collection");
+    delta["media"] = changedRows("Media");
+    delta["deleted"]["collections"] = deletedRows("Collection");
+    delta["deleted"]["media"] = deletedRows("Media");
+
+    return delta.dump();
 }
 
 
-void DatabaseHandler::generateMediaMetadataJson(const std::string& userID, const std::string& profileID) {
-    json userMetadataJson;
+std::string DatabaseHandler::serializeMediaPage(const CatalogPageQuery& page, long long version) {
+    auto db = pool->replica();
 
-    // Get column names for the mediaMetadata table
-    std::vector<std::string> metadataColumns = getColumnNames("mediaMetadata");
+    json result;
+    result["version"] = version;
 
-    // Fetch user metadata for the given userID and profileID
-    CppSQLite3Statement stmt = db.compileStatement("SELECT * FROM mediaMetadata WHERE userID = ? AND profileID = ?;");
-    stmt.bind(1, userID.c_str());
-    stmt.bind(2, profileID.c_str());
+    // Only known columns are spliced into the SQL; ID is always returned so
+    // rows can be merged with later pages and deltas
+    auto project = [&page](const std::vector<std::string>& columns) {
+        if (page.fields.empty()) {
+            return columns;
+        }
+        std::vector<std::string> projected = { "ID" };
+        for (const auto& field : page.fields) {
+            if (field != "ID" && std::find(columns.begin(), columns.end(), field) != columns.end()) {
+                projected.push_back(field);
+            }
+        }
+        return projected;
+    };
+
+    auto selectList = [](const std::vector<std::string>& columns) {
+        std::string list;
+        for (const auto& col : columns) {
+            if (!list.empty()) list += ", ";
+            list += "\"" + col + "\"";
+        }
+        return list;
+    };
+
+    // Columns come back in select-list order, so they are read by position
+    auto readRows = [](CppSQLite3Query& query, const std::vector<std::string>& columns, int limit, json& rows) {
+        int count = 0;
+        while (!query.eof() && count < limit) {
+            json row;
+            for (size_t col = 0; col < columns.size(); col++) {
+                row[columns[col]] = std::string(query.getStringView(static_cast<int>(col)));
+            }
+            rows.push_back(std::move(row));
+            query.nextRow();
+            ++count;
+        }
+        // One row past the limit means there is another page
+        return !query.eof();
+    };
+
+    // Collections are small, so they come whole with the first page
+    result["collections"] = json::array();
+    if (page.cursor.empty()) {
+        std::vector<std::string> collectionColumns = project(columnNames(db, "Collection"));
+        std::string sql = "SELECT " + selectList(collectionColumns) + " FROM Collection WHERE 1";
+        if (!page.collectionID.empty()) {
+            sql += " AND ID = ?";
+        }
+        // The genre join tables turn a genre filter into an index seek
+        // instead of parsing every genres column
+        if (!page.genre.empty()) {
+            sql += " AND ID IN (SELECT collectionID FROM CollectionGenre WHERE genre = ?)";
+        }
+        CppSQLite3Statement& stmt = db.statement(sql + ";");
+        int param = 1;
+        if (!page.collectionID.empty()) {
+            stmt.bind(param++, page.collectionID.c_str());
+        }
+        if (!page.genre.empty()) {
+            stmt.bind(param++, page.genre.c_str());
+        }
+        CppSQLite3Query query = stmt.execQuery();
+        readRows(query, collectionColumns, std::numeric_limits<int>::max(), result["collections"]);
+    }
+
+    std::vector<std::string> mediaColumns = project(columnNames(db, "Media"));
+    std::string sql = "SELECT " + selectList(mediaColumns) + " FROM Media WHERE ID > ?";
+    if (!page.collectionID.empty()) {
+        sql += " AND collection_id = ?";
+    }
+    if (!page.genre.empty()) {
+        sql += " AND ID IN (SELECT mediaID FROM MediaGenre WHERE genre = ?)";
+    }
+    sql += " ORDER BY ID LIMIT ?;";
+
+    CppSQLite3Statement& stmt = db.statement(sql);
+    int param = 1;
+    stmt.bind(param++, page.cursor.c_str());
+    if (!page.collectionID.empty()) {
+        stmt.bind(param++, page.collectionID.c_str());
+    }
+    if (!page.genre.empty()) {
+        stmt.bind(param++, page.genre.c_str());
+    }
+    stmt.bind(param++, page.limit + 1);
     CppSQLite3Query query = stmt.execQuery();
 
-    while (!query.eof()) {
-        json metadataJson;
+    result["media"] = json::array();
+    if (readRows(query, mediaColumns, page.limit, result["media"]) && !result["media"].empty()) {
+        result["nextCursor"] = result["media"].back()["ID"];
+    }
+    else {
+        result["nextCursor"] = nullptr;
+    }
+
+    return result.dump();
+}
+
+
+// SQLite storage class -> JSON type, for the compact encodings
+static json typedField(const CppSQLite3Query& query, int col) {
+    switch (query.fieldDataType(col)) {
+    case SQLITE_INTEGER: return query.getInt64Field(col);
+    case SQLITE_FLOAT: return query.getDoubleField(col);
+    case SQLITE_NULL: return nullptr;
+    default: return std::string(query.getStringView(col));
+    }
+}
+
+// Length of the well-formed UTF-8 sequence starting at text[i], or 0 if it
+// is not one (stray continuation bytes, overlong forms, surrogates, or code
+// points past U+10FFFF)
+static size_t utf8SequenceLength(std::string_view text, size_t i) {
+    unsigned char c = static_cast<unsigned char>(text[i]);
+    size_t length = 0;
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+    if (c >= 0xC2 && c <= 0xDF) {
+        length = 2;
+    }
+    else if (c >= 0xE0 && c <= 0xEF) {
+        length = 3;
+        if (c == 0xE0) low = 0xA0;
+        if (c == 0xED) high = 0x9F;
+    }
+    else if (c >= 0xF0 && c <= 0xF4) {
+        length = 4;
+        if (c == 0xF0) low = 0x90;
+        if (c == 0xF4) high = 0x8F;
+    }
+    else {
+        return 0;
+    }
+
+    if (i + length > text.size()) {
+        return 0;
+    }
+    unsigned char second = static_cast<unsigned char>(text[i + 1]);
+    if (second < low || second > high) {
+        return 0;
+    }
+    for (size_t k = 2; k < length; k++) {
+        unsigned char next = static_cast<unsigned char>(text[i + k]);
+        if (next < 0x80 || next > 0xBF) {
+            return 0;
+        }
+    }
+    return length;
+}
 
-        // Populate JSON dynamically based on columns
-        for (const auto& col : metadataColumns) {
-            metadataJson[col] = query.getStringField(col.c_str());
+// Appends text as a JSON string literal, escaped the way json::dump() does.
+// dump() throws on invalid UTF-8; here each byte that is not part of a
+// well-formed sequence becomes U+FFFD, so the output is always valid JSON.
+// Runs of plain characters are copied in one go.
+static void appendJsonString(std::string& out, std::string_view text) {
+    out += '"';
+    size_t plain = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x80) {
+            size_t length = utf8SequenceLength(text, i);
+            if (length > 0) {
+                i += length - 1;
+                continue;
+            }
+            out.append(text.data() + plain, i - plain);
+            plain = i + 1;
+            out += "\xEF\xBF\xBD";
+            continue;
+        }
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
         }
 
-        userMetadataJson["mediaMetadata"].push_back(metadataJson);
-        query.nextRow();
+        out.append(text.data() + plain, i - plain);
+        plain = i + 1;
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default: {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        }
+        }
     }
+    out.append(text.data() + plain, text.size() - plain);
+    out += '"';
+}
+
+
+CatalogEncodings DatabaseHandler::serializeMediaData(long long version) {
+    auto db = pool->replica();
+
+    // Two outputs come from the same pass: the legacy JSON, where every value
+    // is a string as existing clients expect, written straight from SQLite's
+    // buffers, and a typed tree for CBOR/MessagePack
+    std::string legacy;
+    json typedJson;
+    typedJson["version"] = version;
+
+    auto readTable = [&db, &legacy](const char* sql, json& typedRows) {
+        typedRows = json::array();
+
+        CppSQLite3Query query = db.statement(sql).execQuery();
+        int columns = query.numFields();
+        std::vector<std::string> names;
+        for (int col = 0; col < columns; col++) {
+            names.push_back(query.fieldName(col));
+        }
+
+        // Keys in the same sorted order json::dump() used
+        std::vector<int> order(columns);
+        for (int col = 0; col < columns; col++) order[col] = col;
+        std::sort(order.begin(), order.end(), [&names](int a, int b) { return names[a] < names[b]; });
 
-    // Write to JSON file
-    std::ofstream file("media_metadata.json");
-    file << userMetadataJson.dump(4);  // pretty-print with 4-space indentation
-    file.close();
+        legacy += '[';
+        bool firstRow = true;
+        while (!query.eof()) {
+            if (!firstRow) legacy += ',';
+            firstRow = false;
+
+            json typedRow;
+            legacy += '{';
+            for (int i = 0; i < columns; i++) {
+                int col = order[i];
+                if (i > 0) legacy += ',';
+                appendJsonString(legacy, names[col]);
+                legacy += ':';
+                appendJsonString(legacy, query.getStringView(col));
+                typedRow[names[col]] = typedField(query, col);
+            }
+            legacy += '}';
+            typedRows.push_back(std::move(typedRow));
+            query.nextRow();
+        }
+        legacy += ']';
+    };
+
+    legacy += "{\"collections\":";
+    readTable("SELECT * FROM Collection;", typedJson["collections"]);
+    legacy += ",\"media\":";
+    readTable("SELECT * FROM Media;", typedJson["media"]);
+    legacy += ",\"version\":" + std::to_string(version) + "}";
+
+    CatalogEncodings encodings;
+    encodings.json = std::move(legacy);
+    std::vector<std::uint8_t> cbor = json::to_cbor(typedJson);
+    encodings.cbor.assign(cbor.begin(), cbor.end());
+    std::vector<std::uint8_t> msgpack = json::to_msgpack(typedJson);
+    encodings.msgpack.assign(msgpack.begin(), msgpack.end());
+    return encodings;
+}
+
+
+std::vector<MediaProgress> DatabaseHandler::getMediaMetadata(const std::string& userID, const std::string& profileID) {
+    auto db = pool->reader();
+
+    static const std::string sql = "SELECT " + selectList<MediaProgress>() +
+        " FROM mediaMetadata WHERE userID = ? AND profileID = ? ORDER BY rowid DESC;";
+    CppSQLite3Statement& stmt = db.statement(sql);
+    stmt.bind(1, userID.c_str());
+    stmt.bind(2, profileID.c_str());
+    CppSQLite3Query query = stmt.execQuery();
+    return readRows<MediaProgress>(query);
+}
+
+std::vector<EpisodeRow> DatabaseHandler::getEpisodes() {
+    auto db = pool->replica();
+
+    static const std::string sql = "SELECT " + selectList<EpisodeRow>() + R"( FROM Media
+        WHERE collection_id IS NOT NULL AND type = 'episode'
+        ORDER BY collection_id, season, episode;)";
+    CppSQLite3Query query = db.statement(sql).execQuery();
+    return readRows<EpisodeRow>(query);
 }
 
 int DatabaseHandler::insertMediaMetadata(
@@ -377,34 +936,50 @@ int DatabaseHandler::insertMediaMetadata(
     const std::string& languageChosen,
     const std::string& subtitlesChosen
 ) {
-    try {
-        // Prepare the SQL insert statement
-        const char* sql = R"(
-            INSERT OR REPLACE INTO mediaMetadata (
-                userID,
-                profileID,
-                mediaID,
-                percentage_watched,
-                language_chosen,
-                subtitles_chosen
-            ) VALUES (?, ?, ?, ?, ?, ?);
-        )";
-
-        CppSQLite3Statement stmt = db.compileStatement(sql);
-
-        // Bind values to the prepared statement
-        stmt.bind(1, userID.c_str());
-        stmt.bind(2, profileID.c_str());
-        stmt.bind(3, mediaID.c_str());
-        stmt.bind(4, percentageWatched);
-        stmt.bind(5, languageChosen.c_str());
-        stmt.bind(6, subtitlesChosen.c_str());
+    MediaProgress progress;
+    progress.userID = userID;
+    progress.profileID = profileID;
+    progress.mediaID = mediaID;
+    progress.percentageWatched = percentageWatched;
+    progress.languageChosen = languageChosen;
+    progress.subtitlesChosen = subtitlesChosen;
+    return insertMediaMetadataBatch({ progress });
+}
 
-        // Execute the statement
-        stmt.execDML();
+int DatabaseHandler::insertMediaMetadataBatch(const std::vector<MediaProgress>& batch) {
+    if (batch.empty()) {
         return 0;
     }
+
+    try {
+        // One write: the committer's savepoint makes the batch all or nothing
+        return writes->submit([&](ConnectionPool::Lease& db) {
+            CppSQLite3Statement& stmt = db.statement(R"(
+                INSERT OR REPLACE INTO mediaMetadata (
+                    userID,
+                    profileID,
+                    mediaID,
+                    percentage_watched,
+                    language_chosen,
+                    subtitles_chosen
+                ) VALUES (?, ?, ?, ?, ?, ?);
+            )");
+
+            // One compiled statement, rebound for every row
+            for (const MediaProgress& progress : batch) {
+                stmt.bind(1, progress.userID.c_str());
+                stmt.bind(2, progress.profileID.c_str());
+                stmt.bind(3, progress.mediaID.c_str());
+                stmt.bind(4, progress.percentageWatched);
+                stmt.bind(5, progress.languageChosen.c_str());
+                stmt.bind(6, progress.subtitlesChosen.c_str());
+                stmt.execDML();
+            }
+            return 0;
+            }).get();
+    }
     catch (const std::exception& e) {
+        std::cerr << "Failed to write media metadata: " << e.what() << std::endl;
         return 1;
     }
 }
@@ -412,11 +987,13 @@ int DatabaseHandler::insertMediaMetadata(
 
 
 std::string DatabaseHandler::getImagePathById(const std::string& id, const std::string& coversPath) {
+    auto db = pool->replica();
+
     try {
         fs::path coversFolder = coversPath;
 
         // Check if the ID exists in the Collection table
-        CppSQLite3Statement stmtCollection = db.compileStatement("SELECT ID FROM Collection WHERE ID = ?;");
+        CppSQLite3Statement& stmtCollection = db.statement("SELECT ID FROM Collection WHERE ID = ?;");
         stmtCollection.bind(1, id.c_str());
         CppSQLite3Query queryCollection = stmtCollection.execQuery();
 
@@ -430,7 +1007,7 @@ std::string DatabaseHandler::getImagePathById(const std::string& id, const std::
         }
 
         // If not found in Collection, check the Media table
-        CppSQLite3Statement stmtMedia = db.compileStatement("SELECT ID FROM Media WHERE ID = ?;");
+        CppSQLite3Statement& stmtMedia = db.statement("SELECT ID FROM Media WHERE ID = ?;");
         stmtMedia.bind(1, id.c_str());
         CppSQLite3Query queryMedia = stmtMedia.execQuery();
 
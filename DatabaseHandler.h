@@ -1,18 +1,125 @@
 #ifndef DATABASEHANDLER_H
 #define DATABASEHANDLER_H
 
+#include "ConnectionPool.h"
 #include "CppSQLite3.h"
+#include "DbExecutor.h"
+#include "GroupCommitter.h"
+#include "WalCheckpointer.h"
+#include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
+// One page of /media/data: keyset pagination over Media.ID, an optional
+// column projection and an optional collection scope.
+struct CatalogPageQuery {
+    int limit = 200;
+    std::string cursor;                 // Last Media ID of the previous page
+    std::vector<std::string> fields;    // Empty for every column
+    std::string collectionID;           // Empty for the whole library
+    std::string genre;                  // Empty for every genre
+};
+
+// The full catalog in every encoding /media/data can negotiate
+struct CatalogEncodings {
+    std::string json;       // Minified, every value a string (legacy clients)
+    std::string cbor;       // Typed values: numbers, strings and nulls
+    std::string msgpack;
+};
+
+// One row of Media; NULL columns read as empty strings and zeros
+struct MediaRecord {
+    std::string id;
+    std::string title;
+    std::string year;
+    std::string description;
+    std::string producer;
+    double rating = 0.0;
+    int season = 0;
+    int episode = 0;
+    std::string resolution;
+    std::string imagePath;
+    std::string genres;         // JSON-encoded list
+    std::string type;           // "movie" or "episode"
+    std::string collectionID;
+};
+
+// One row of Collection
+struct CollectionRecord {
+    std::string id;
+    std::string title;
+    std::string description;
+    double rating = 0.0;
+    std::string type;           // "movies" or "serie"
+    std::string genres;         // JSON-encoded list
+    std::string producer;
+    std::string imagePath;
+};
+
+// One row of Profile
+struct ProfileRecord {
+    std::string userID;
+    std::string profileID;
+    std::string pictureID;
+};
+
+// One row of mediaMetadata: where a profile is in a media and what it picked
+struct MediaProgress {
+    std::string userID;
+    std::string profileID;
+    std::string mediaID;
+    double percentageWatched = 0.0;
+    std::string languageChosen;
+    std::string subtitlesChosen;
+};
+
+// Where an episode sits in its collection
+struct EpisodeRow {
+    std::string mediaID;
+    std::string collectionID;
+    int season = 0;
+    int episode = 0;
+};
+
+// The "sqlite" block of config.json
+struct DatabaseOptions {
+    PragmaProfile pragmas;
+    CheckpointPolicy checkpoints;
+    size_t executorQueue = 1024;    // Database tasks waiting before post() refuses more
+    GroupCommitPolicy groupCommit;
+};
+
 class DatabaseHandler {
 public:
-    DatabaseHandler(const std::string& dbPath);
+    // readers = 0 sizes the connection pool for the crow workers
+    DatabaseHandler(const std::string& dbPath, size_t readers = 0, const DatabaseOptions& options = DatabaseOptions());
     ~DatabaseHandler();
 
+    // Runs work(*this) on a database thread. Any method can be called this
+    // way; the synchronous ones stay for threads that already own their time
+    // (the catalog poller, the progress flusher).
+    template <typename Fn>
+    auto async(Fn work) -> std::future<std::invoke_result_t<Fn&, DatabaseHandler&>> {
+        return executor->submit([this, work = std::move(work)]() mutable { return work(*this); });
+    }
+
+    // Callback form for request handlers: done(future) runs on the database
+    // thread once work finishes. False when the queue is full.
+    template <typename Fn, typename Done>
+    bool post(Fn work, Done done) {
+        return executor->post([this, work = std::move(work)]() mutable { return work(*this); }, std::move(done));
+    }
+
+    size_t getQueuedTasks() const;
+    GroupCommitStats getWriteStats() const;
+
+    // Mutations are group-committed: they return once the transaction their
+    // write was batched into has committed
     bool addProfile(const std::string& userID, const std::string& profileID, int pictureID);
     bool deleteProfile(const std::string& userID, const std::string& profileID);
-    void getProfiles(const std::string& userID, std::vector<std::pair<std::string, std::string>>& profiles);
+    std::vector<ProfileRecord> getProfiles(const std::string& userID);
+    bool profileExists(const std::string& userID, const std::string& profileID);
 
     std::string getPassword(const std::string& userID);
     std::vector<std::pair<std::string, std::string>> getAllUserPasswords();
@@ -20,15 +127,40 @@ public:
 
 
 
-    std::vector<std::string> getAllCollections();
-    std::string getCollectionById(const std::string& collectionId);
-    std::vector<std::string> getAllMediaIdsFromCollection(const std::string& collectionId);
-    std::string getMediaDataById(const std::string& mediaId);
-    std::vector<std::string> getAllMediaMetadataByMediaId(const std::string& mediaId);
+    std::vector<CollectionRecord> getAllCollections();
+    std::optional<CollectionRecord> getCollectionById(const std::string& collectionId);
+    // Ordered by (season, episode)
+    std::vector<MediaRecord> getMediaByCollection(const std::string& collectionId);
+    std::optional<MediaRecord> getMediaById(const std::string& mediaId);
+    std::vector<MediaProgress> getAllMediaMetadataByMediaId(const std::string& mediaId);
 
     std::vector<std::string> getColumnNames(const std::string& tableName);
-    void generateMediaDataJson();
-    void generateMediaMetadataJson(const std::string& userID, const std::string& profileID);
+    ConnectionPool::StatementStats getStatementStats() const;
+    const std::string& getJournalMode() const;
+    // All zeros unless the database is in WAL mode
+    CheckpointStats getCheckpointStats() const;
+    long long getDataVersion();
+
+    // Catalog reads (Media, Collection and their change log) are served by
+    // in-memory replicas of the database. The catalog cache refreshes them
+    // whenever getDataVersion() moves; until the first refresh they read
+    // from disk.
+    void refreshReplica();
+    ConnectionPool::ReplicaStats getReplicaStats() const;
+
+    // Catalog versions come from the CatalogChange log. Callers read the
+    // version first and then serialize, so a snapshot may be labelled older
+    // than its rows; replaying a delta over it is harmless.
+    long long getCatalogVersion();
+    long long getOldestCatalogDelta();
+    void pruneCatalogChanges(long long keep);
+    CatalogEncodings serializeMediaData(long long version);
+    std::string serializeMediaDataSince(long long since, long long version);
+    std::string serializeMediaPage(const CatalogPageQuery& page, long long version);
+    // Most recently written first
+    std::vector<MediaProgress> getMediaMetadata(const std::string& userID, const std::string& profileID);
+    // Every episode, ordered by (collection_id, season, episode)
+    std::vector<EpisodeRow> getEpisodes();
     int insertMediaMetadata(
         const std::string& userID,
         const std::string& profileID,
@@ -37,10 +169,29 @@ public:
         const std::string& languageChosen,
         const std::string& subtitlesChosen
     );
+    // Writes every row in the same transaction; all or nothing
+    int insertMediaMetadataBatch(const std::vector<MediaProgress>& batch);
     std::string getImagePathById(const std::string& id, const std::string& coversPath);
 
 private:
-    CppSQLite3DB db;
+    // Brings the schema up to the latest PRAGMA user_version
+    void migrate();
+    static std::vector<std::string> columnNames(ConnectionPool::Lease& db, const std::string& tableName);
+
+    // Outlives the pool, whose writer calls into it on every commit
+    std::unique_ptr<WalCheckpointer> checkpointer;
+
+    // Every method checks out its own connection, so the handler can be
+    // shared by all request threads
+    std::unique_ptr<ConnectionPool> pool;
+
+    // Every mutation after startup goes through here, batched into shared
+    // transactions on the writer
+    std::unique_ptr<GroupCommitter> writes;
+
+    // One thread per reader connection; destroyed first, so queued work
+    // still finds the pool and the committer
+    std::unique_ptr<DbExecutor> executor;
 };
 
 #endif // DATABASEHANDLER_H
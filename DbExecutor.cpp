@@ -0,0 +1,69 @@
+#include "DbExecutor.h"
+#include <exception>
+#include <iostream>
+
+DbExecutor::DbExecutor(size_t workerCount, size_t capacity)
+    : capacity(capacity) {
+    for (size_t i = 0; i < workerCount; i++) {
+        workers.emplace_back(&DbExecutor::workerLoop, this);
+    }
+}
+
+DbExecutor::~DbExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    notEmpty.notify_all();
+    notFull.notify_all();
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+size_t DbExecutor::queued() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tasks.size();
+}
+
+bool DbExecutor::enqueue(std::function<void()> task, bool wait) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (wait) {
+            notFull.wait(lock, [this] { return stopping || tasks.size() < capacity; });
+        }
+        if (stopping || tasks.size() >= capacity) {
+            return false;
+        }
+        tasks.push_back(std::move(task));
+    }
+    notEmpty.notify_one();
+    return true;
+}
+
+void DbExecutor::workerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [this] { return stopping || !tasks.empty(); });
+            // Drain what was accepted before stopping
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        notFull.notify_one();
+
+        try {
+            task();
+        }
+        catch (const std::exception& e) {
+            // Work exceptions land in the future; this is a throwing callback
+            std::cerr << "Database task failed: " << e.what() << std::endl;
+        }
+    }
+}
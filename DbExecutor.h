@@ -0,0 +1,65 @@
+#ifndef DBEXECUTOR_H
+#define DBEXECUTOR_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Threads dedicated to SQL, fed by a bounded queue, so a lock wait or a slow
+// write stalls a database thread instead of a crow worker that could be
+// streaming chunks. Work is a callable run on one of the threads; results
+// come back through a std::future.
+class DbExecutor {
+public:
+    DbExecutor(size_t workers, size_t capacity);
+    ~DbExecutor();
+
+    DbExecutor(const DbExecutor&) = delete;
+    DbExecutor& operator=(const DbExecutor&) = delete;
+
+    // Waits for room in the queue
+    template <typename Fn>
+    auto submit(Fn work) -> std::future<std::invoke_result_t<Fn&>> {
+        using Result = std::invoke_result_t<Fn&>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(work));
+        std::future<Result> result = task->get_future();
+        enqueue([task] { (*task)(); }, true);
+        return result;
+    }
+
+    // Runs work, then done(future) on the same thread with the result or the
+    // exception ready. Returns false, without running anything, when the
+    // queue is full.
+    template <typename Fn, typename Done>
+    bool post(Fn work, Done done) {
+        using Result = std::invoke_result_t<Fn&>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(work));
+        return enqueue([task, done = std::move(done)]() mutable {
+            (*task)();
+            done(task->get_future());
+        }, false);
+    }
+
+    size_t queued() const;
+
+private:
+    bool enqueue(std::function<void()> task, bool wait);
+    void workerLoop();
+
+    const size_t capacity;
+
+    mutable std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<std::function<void()>> tasks;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+};
+
+#endif // DBEXECUTOR_H
@@ -0,0 +1,22 @@
+#include "EpisodeIndex.h"
+
+EpisodeIndex::EpisodeIndex(std::vector<EpisodeRow> rows) : rows(std::move(rows)) {
+    positions.reserve(this->rows.size());
+    for (size_t i = 0; i < this->rows.size(); i++) {
+        positions.emplace(this->rows[i].mediaID, i);
+    }
+}
+
+const EpisodeRow* EpisodeIndex::find(const std::string& mediaID) const {
+    auto it = positions.find(mediaID);
+    return it != positions.end() ? &rows[it->second] : nullptr;
+}
+
+const EpisodeRow* EpisodeIndex::next(const std::string& mediaID) const {
+    auto it = positions.find(mediaID);
+    if (it == positions.end() || it->second + 1 >= rows.size()) {
+        return nullptr;
+    }
+    const EpisodeRow& following = rows[it->second + 1];
+    return following.collectionID == rows[it->second].collectionID ? &following : nullptr;
+}
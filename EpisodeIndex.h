@@ -0,0 +1,27 @@
+#ifndef EPISODEINDEX_H
+#define EPISODEINDEX_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "DatabaseHandler.h"
+
+// Episodes in (collection, season, episode) order with a lookup by media ID,
+// so the episode after any given one is a hash lookup and an increment.
+class EpisodeIndex {
+public:
+    // Rows must already be sorted, as DatabaseHandler::getEpisodes returns them
+    explicit EpisodeIndex(std::vector<EpisodeRow> rows);
+
+    // nullptr for movies and unknown IDs
+    const EpisodeRow* find(const std::string& mediaID) const;
+
+    // nullptr after the last episode of a collection
+    const EpisodeRow* next(const std::string& mediaID) const;
+
+private:
+    std::vector<EpisodeRow> rows;
+    std::unordered_map<std::string, size_t> positions;
+};
+
+#endif // EPISODEINDEX_H
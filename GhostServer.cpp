@@ -7,7 +7,7 @@
 
 using json = nlohmann::json;
 
-void loadPaths(const std::string& configFilePath, std::string& databasePath, std::string& coversPath, std::string& chunksPath, std::string& duckdnsDomain) {
+void loadPaths(const std::string& configFilePath, std::string& databasePath, std::string& coversPath, std::string& chunksPath, std::string& duckdnsDomain, int& progressFlushMs, DatabaseOptions& databaseOptions) {
     std::ifstream configFile(configFilePath);
     if (!configFile.is_open()) {
         throw std::runtime_error("Could not open configuration file: " + configFilePath);
@@ -40,6 +40,37 @@ void loadPaths(const std::string& configFilePath, std::string& databasePath, std
     else {
         throw std::runtime_error("Invalid configuration: 'duckdnsDomain' not found or incorrect type.");
     }
+    // Optional: how often buffered watch progress is written to the database
+    if (configJson.contains("progressFlushMs") && configJson["progressFlushMs"].is_number_integer()) {
+        progressFlushMs = configJson["progressFlushMs"].get<int>();
+    }
+    // Optional: SQLite pragmas and WAL checkpoint policy
+    if (configJson.contains("sqlite") && configJson["sqlite"].is_object()) {
+        const json& sqlite = configJson["sqlite"];
+        PragmaProfile& pragmas = databaseOptions.pragmas;
+        pragmas.journalMode = sqlite.value("journalMode", pragmas.journalMode);
+        pragmas.synchronous = sqlite.value("synchronous", pragmas.synchronous);
+        pragmas.mmapSize = sqlite.value("mmapSizeMB", pragmas.mmapSize / (1024 * 1024)) * 1024 * 1024;
+        pragmas.cacheSizeKiB = sqlite.value("cacheSizeKB", pragmas.cacheSizeKiB);
+        pragmas.tempStore = sqlite.value("tempStore", pragmas.tempStore);
+        pragmas.busyTimeoutMs = sqlite.value("busyTimeoutMs", pragmas.busyTimeoutMs);
+        if (sqlite.contains("journalSizeLimitMB") && sqlite["journalSizeLimitMB"].is_number_integer()) {
+            long long limitMB = sqlite["journalSizeLimitMB"].get<long long>();
+            pragmas.journalSizeLimit = limitMB < 0 ? -1 : limitMB * 1024 * 1024;
+        }
+
+        CheckpointPolicy& checkpoints = databaseOptions.checkpoints;
+        checkpoints.walPages = sqlite.value("checkpointPages", checkpoints.walPages);
+        checkpoints.interval = std::chrono::milliseconds(
+            sqlite.value("checkpointIntervalMs", static_cast<long long>(checkpoints.interval.count())));
+
+        databaseOptions.executorQueue = sqlite.value("executorQueue", databaseOptions.executorQueue);
+
+        GroupCommitPolicy& groupCommit = databaseOptions.groupCommit;
+        groupCommit.window = std::chrono::milliseconds(
+            sqlite.value("groupCommitMs", static_cast<long long>(groupCommit.window.count())));
+        groupCommit.maxBatch = sqlite.value("groupCommitMax", groupCommit.maxBatch);
+    }
 }
 
 
@@ -65,12 +96,14 @@ int main() {
         std::string coversPath;
         std::string chunksPath;
         std::string duckdnsDomain; 
+        int progressFlushMs = 5000;
+        DatabaseOptions databaseOptions;
         
-        loadPaths(configFilePath, databasePath, coversPath, chunksPath, duckdnsDomain);
+        loadPaths(configFilePath, databasePath, coversPath, chunksPath, duckdnsDomain, progressFlushMs, databaseOptions);
         std::cout << "Database path loaded from config: " << databasePath << std::endl;
 
         // Create and initialize the DatabaseHandler with the database path
-        DatabaseHandler dbHandler(databasePath);
+        DatabaseHandler dbHandler(databasePath, 0, databaseOptions);
 
         // Start your server logic here, for example:
         std::cout << "Server starting..." << std::endl;
@@ -78,7 +111,7 @@ int main() {
         // Initialize the API with the database handler
         
 
-        API api(dbHandler, coversPath, chunksPath, duckdnsDomain);
+        API api(dbHandler, coversPath, chunksPath, duckdnsDomain, std::chrono::milliseconds(progressFlushMs));
         std::cout << "Public IP: " << api.getPublicIP(duckdnsDomain) << std::endl;
         // Run the API server on a specified port
         api.run(38080);
@@ -0,0 +1,148 @@
+#include "GroupCommitter.h"
+#include <iostream>
+#include <stdexcept>
+
+GroupCommitter::GroupCommitter(ConnectionPool& pool, const GroupCommitPolicy& policy)
+    : pool(pool), policy(policy) {
+    writer = std::thread(&GroupCommitter::writerLoop, this);
+}
+
+GroupCommitter::~GroupCommitter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (writer.joinable()) {
+        writer.join();
+    }
+}
+
+GroupCommitStats GroupCommitter::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return totals;
+}
+
+void GroupCommitter::enqueue(Write write) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!stopping) {
+            pending.push_back(std::move(write));
+            wake.notify_all();
+            return;
+        }
+    }
+    // The writer thread may already be gone; nobody would answer
+    write.fail(std::make_exception_ptr(std::runtime_error("Database writer is shutting down")));
+}
+
+void GroupCommitter::commitBatch(std::vector<Write>& batch) {
+    auto db = pool.writer();
+
+    try {
+        db->execDML("BEGIN IMMEDIATE;");
+    }
+    catch (const CppSQLite3Exception&) {
+        std::exception_ptr error = std::current_exception();
+        for (Write& write : batch) {
+            write.fail(error);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        totals.failedWrites += batch.size();
+        return;
+    }
+
+    std::vector<Write*> applied;
+    applied.reserve(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        Write& write = batch[i];
+        try {
+            db->execDML("SAVEPOINT write;");
+            write.apply(db);
+            db.releaseStatements();
+            db->execDML("RELEASE write;");
+            applied.push_back(&write);
+        }
+        catch (...) {
+            std::exception_ptr error = std::current_exception();
+            try {
+                db.releaseStatements();
+                db->execDML("ROLLBACK TO write; RELEASE write;");
+            }
+            catch (const CppSQLite3Exception& e) {
+                // Some errors (disk full, I/O) end the whole transaction, taking
+                // the writes before this one with it
+                std::cerr << "Write transaction aborted: " << e.errorMessage() << std::endl;
+                try {
+                    db->execDML("ROLLBACK;");
+                }
+                catch (const CppSQLite3Exception&) {
+                    // Usually already rolled back
+                }
+                for (size_t j = i; j < batch.size(); j++) {
+                    applied.push_back(&batch[j]);
+                }
+                for (Write* lost : applied) {
+                    lost->fail(error);
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                totals.failedWrites += batch.size();
+                return;
+            }
+            write.fail(error);
+        }
+    }
+
+    try {
+        db->execDML("COMMIT;");
+    }
+    catch (const CppSQLite3Exception&) {
+        std::exception_ptr error = std::current_exception();
+        try {
+            db->execDML("ROLLBACK;");
+        }
+        catch (const CppSQLite3Exception&) {
+            // A failed COMMIT may already have ended the transaction
+        }
+        for (Write* write : applied) {
+            write->fail(error);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        totals.failedWrites += batch.size();
+        return;
+    }
+
+    for (Write* write : applied) {
+        write->commit();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ++totals.transactions;
+    totals.writes += applied.size();
+    totals.failedWrites += batch.size() - applied.size();
+}
+
+void GroupCommitter::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return stopping || !pending.empty(); });
+        if (pending.empty()) {
+            return;
+        }
+
+        // Give concurrent handlers the window to join this transaction
+        if (!stopping && policy.window.count() > 0) {
+            wake.wait_for(lock, policy.window, [this] { return stopping || pending.size() >= policy.maxBatch; });
+        }
+
+        std::vector<Write> batch;
+        while (!pending.empty() && (batch.empty() || batch.size() < policy.maxBatch)) {
+            batch.push_back(std::move(pending.front()));
+            pending.pop_front();
+        }
+
+        lock.unlock();
+        commitBatch(batch);
+        lock.lock();
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef GROUPCOMMITTER_H
+#define GROUPCOMMITTER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "ConnectionPool.h"
+
+// How writes are grouped into transactions
+struct GroupCommitPolicy {
+    std::chrono::milliseconds window{ 2 };  // How long a batch collects writes after the first one
+    size_t maxBatch = 256;                  // Commits early once this many are waiting
+};
+
+struct GroupCommitStats {
+    unsigned long long transactions = 0;
+    unsigned long long writes = 0;
+    unsigned long long failedWrites = 0;
+};
+
+// The only thread that writes to the database. Mutations from every handler
+// are queued, and each batch runs in one transaction on the pool's writer:
+// one commit, and one fsync, for all of them. Each mutation runs inside its
+// own savepoint, so a failing one is rolled back alone and reports its own
+// error. Results are only delivered once the batch has committed.
+class GroupCommitter {
+public:
+    GroupCommitter(ConnectionPool& pool, const GroupCommitPolicy& policy = GroupCommitPolicy());
+    ~GroupCommitter();
+
+    GroupCommitter(const GroupCommitter&) = delete;
+    GroupCommitter& operator=(const GroupCommitter&) = delete;
+
+    // mutation(lease) runs on the writer thread inside the batch transaction.
+    // It must not BEGIN or COMMIT itself; throwing rolls back just this one.
+    template <typename Fn>
+    auto submit(Fn mutation) -> std::future<std::invoke_result_t<Fn&, ConnectionPool::Lease&>> {
+        using Result = std::invoke_result_t<Fn&, ConnectionPool::Lease&>;
+        static_assert(!std::is_void_v<Result>, "Mutations return their result");
+
+        struct State {
+            std::promise<Result> promise;
+            std::optional<Result> value;
+        };
+        auto state = std::make_shared<State>();
+        std::future<Result> result = state->promise.get_future();
+
+        Write write;
+        write.apply = [state, mutation = std::move(mutation)](ConnectionPool::Lease& db) mutable {
+            state->value.emplace(mutation(db));
+        };
+        write.commit = [state] { state->promise.set_value(std::move(*state->value)); };
+        write.fail = [state](std::exception_ptr error) { state->promise.set_exception(error); };
+        enqueue(std::move(write));
+        return result;
+    }
+
+    GroupCommitStats stats() const;
+
+private:
+    struct Write {
+        std::function<void(ConnectionPool::Lease&)> apply;
+        std::function<void()> commit;
+        std::function<void(std::exception_ptr)> fail;
+    };
+
+    void enqueue(Write write);
+    void commitBatch(std::vector<Write>& batch);
+    void writerLoop();
+
+    ConnectionPool& pool;
+    const GroupCommitPolicy policy;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Write> pending;
+    bool stopping = false;
+    GroupCommitStats totals;
+    std::thread writer;
+};
+
+#endif // GROUPCOMMITTER_H
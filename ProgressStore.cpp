@@ -0,0 +1,287 @@
+#include "ProgressStore.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json.hpp>
+using json = nlohmann::json;
+
+// Progress is a percentage; below the first mark nothing was really watched,
+// past the second the media counts as finished
+static const double startedPercent = 1.0;
+static const double finishedPercent = 95.0;
+
+// Same text SQLite produces for a REAL, so cached replies match the old ones
+static std::string formatReal(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+    if (!std::strpbrk(buffer, ".eni")) {
+        std::strcat(buffer, ".0");
+    }
+    return buffer;
+}
+
+ProgressStore::ProgressStore(DatabaseHandler& dbHandler, std::chrono::milliseconds flushInterval)
+    : db(dbHandler), flushInterval(flushInterval) {
+    flusher = std::thread(&ProgressStore::flushLoop, this);
+}
+
+ProgressStore::~ProgressStore() {
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        stopping = true;
+    }
+    stopCondition.notify_all();
+    if (flusher.joinable()) {
+        flusher.join();
+    }
+
+    if (!flush()) {
+        std::cerr << "Watch progress lost on shutdown: " << pending.size() << " updates" << std::endl;
+    }
+}
+
+std::string ProgressStore::keyFor(const std::string& userID, const std::string& profileID) {
+    // IDs never contain the unit separator
+    return userID + '\x1f' + profileID;
+}
+
+std::string ProgressStore::keyFor(const MediaProgress& progress) {
+    return keyFor(progress.userID, progress.profileID) + '\x1f' + progress.mediaID;
+}
+
+// Pending updates in the order they were recorded, so replaying them leaves
+// the latest one on top
+std::vector<const ProgressStore::PendingUpdate*> ProgressStore::inOrder(const PendingMap& updates) {
+    std::vector<const PendingUpdate*> ordered;
+    ordered.reserve(updates.size());
+    for (const auto& entry : updates) {
+        ordered.push_back(&entry.second);
+    }
+    std::sort(ordered.begin(), ordered.end(),
+        [](const PendingUpdate* a, const PendingUpdate* b) { return a->sequence < b->sequence; });
+    return ordered;
+}
+
+ProgressStore::Profile& ProgressStore::profileFor(const std::string& userID, const std::string& profileID) {
+    std::string key = keyFor(userID, profileID);
+    auto it = profiles.find(key);
+    if (it != profiles.end()) {
+        return *it->second;
+    }
+
+    // Any authenticated caller can name a profile, so only real ones are
+    // cached; the rest share one empty profile and cost a lookup each time
+    if (!db.profileExists(userID, profileID)) {
+        return missing;
+    }
+
+    // Callers hold flushMutex, so no batch is half-written while we read;
+    // anything not yet flushed is still in pending and wins over the table.
+    // Nothing is stored until the load succeeds.
+    auto profile = std::make_unique<Profile>();
+    for (auto& row : db.getMediaMetadata(userID, profileID)) {
+        profile->recent.push_back(row.mediaID);
+        std::string mediaID = row.mediaID;
+        profile->media[mediaID] = std::move(row);
+    }
+    for (const PendingUpdate* update : inOrder(pending)) {
+        const MediaProgress& progress = update->progress;
+        if (progress.userID == userID && progress.profileID == profileID) {
+            touch(*profile, progress);
+        }
+    }
+    auto& slot = profiles[key];
+    slot = std::move(profile);
+    return *slot;
+}
+
+void ProgressStore::forget(const std::string& userID, const std::string& profileID) {
+    std::lock_guard<std::mutex> lock(mutex);
+    profiles.erase(keyFor(userID, profileID));
+    for (auto it = pending.begin(); it != pending.end();) {
+        const MediaProgress& progress = it->second.progress;
+        bool deleted = progress.userID == userID && progress.profileID == profileID;
+        it = deleted ? pending.erase(it) : std::next(it);
+    }
+}
+
+void ProgressStore::record(const MediaProgress& progress) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending[keyFor(progress)] = PendingUpdate{ nextSequence++, progress };
+
+    // Profiles nobody has read yet are loaded on first read instead
+    auto it = profiles.find(keyFor(progress.userID, progress.profileID));
+    if (it != profiles.end() && it->second) {
+        touch(*it->second, progress);
+    }
+}
+
+void ProgressStore::touch(Profile& profile, const MediaProgress& progress) {
+    profile.media[progress.mediaID] = progress;
+
+    // Keep the update order current by moving the media to the front
+    auto position = std::find(profile.recent.begin(), profile.recent.end(), progress.mediaID);
+    if (position != profile.recent.end()) {
+        profile.recent.erase(position);
+    }
+    profile.recent.insert(profile.recent.begin(), progress.mediaID);
+
+    profile.json.clear();
+    profile.continueJson.clear();
+}
+
+std::string ProgressStore::serialize(const std::string& userID, const std::string& profileID) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = profiles.find(keyFor(userID, profileID));
+        if (it != profiles.end() && it->second && !it->second->json.empty()) {
+            return it->second->json;
+        }
+    }
+
+    std::lock_guard<std::mutex> flushLock(flushMutex);
+    std::lock_guard<std::mutex> lock(mutex);
+    Profile* profile = &profileFor(userID, profileID);
+
+    if (profile->json.empty()) {
+        json userMetadataJson;
+        userMetadataJson["mediaMetadata"] = json::array();
+        for (const auto& entry : profile->media) {
+            const MediaProgress& progress = entry.second;
+            userMetadataJson["mediaMetadata"].push_back({
+                { "userID", progress.userID },
+                { "profileID", progress.profileID },
+                { "mediaID", progress.mediaID },
+                { "percentage_watched", formatReal(progress.percentageWatched) },
+                { "language_chosen", progress.languageChosen },
+                { "subtitles_chosen", progress.subtitlesChosen }
+            });
+        }
+        profile->json = userMetadataJson.dump();
+    }
+    return profile->json;
+}
+
+std::shared_ptr<const EpisodeIndex> ProgressStore::episodesFor(long long catalogVersion) {
+    std::lock_guard<std::mutex> lock(episodesMutex);
+    if (!episodes || episodesVersion != catalogVersion) {
+        episodes = std::make_shared<const EpisodeIndex>(db.getEpisodes());
+        episodesVersion = catalogVersion;
+    }
+    return episodes;
+}
+
+std::string ProgressStore::buildContinueWatching(const Profile& profile, const EpisodeIndex& episodes, long long catalogVersion) {
+    json items = json::array();
+    std::unordered_set<std::string> collections;
+
+    for (const std::string& mediaID : profile.recent) {
+        const MediaProgress& progress = profile.media.at(mediaID);
+        const EpisodeRow* episode = episodes.find(mediaID);
+
+        // Only the most recent activity in a collection counts
+        if (episode && !collections.insert(episode->collectionID).second) {
+            continue;
+        }
+
+        if (progress.percentageWatched < finishedPercent) {
+            if (progress.percentageWatched >= startedPercent) {
+                items.push_back({
+                    { "mediaID", mediaID },
+                    { "collectionID", episode ? json(episode->collectionID) : json(nullptr) },
+                    { "percentage_watched", progress.percentageWatched },
+                    { "reason", "resume" }
+                });
+            }
+            continue;
+        }
+
+        const EpisodeRow* next = episode ? episodes.next(mediaID) : nullptr;
+        if (!next) {
+            continue;
+        }
+        auto nextProgress = profile.media.find(next->mediaID);
+        double watched = nextProgress != profile.media.end() ? nextProgress->second.percentageWatched : 0.0;
+        if (watched < finishedPercent) {
+            items.push_back({
+                { "mediaID", next->mediaID },
+                { "collectionID", next->collectionID },
+                { "percentage_watched", watched },
+                { "reason", "next" }
+            });
+        }
+    }
+
+    json result;
+    result["catalogVersion"] = catalogVersion;
+    result["continueWatching"] = std::move(items);
+    return result.dump();
+}
+
+std::string ProgressStore::continueWatching(const std::string& userID, const std::string& profileID, long long catalogVersion) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = profiles.find(keyFor(userID, profileID));
+        if (it != profiles.end() && it->second && !it->second->continueJson.empty() &&
+            it->second->continueVersion == catalogVersion) {
+            return it->second->continueJson;
+        }
+    }
+
+    auto index = episodesFor(catalogVersion);
+
+    std::lock_guard<std::mutex> flushLock(flushMutex);
+    std::lock_guard<std::mutex> lock(mutex);
+    Profile* profile = &profileFor(userID, profileID);
+
+    if (profile->continueJson.empty() || profile->continueVersion != catalogVersion) {
+        profile->continueJson = buildContinueWatching(*profile, *index, catalogVersion);
+        profile->continueVersion = catalogVersion;
+    }
+    return profile->continueJson;
+}
+
+bool ProgressStore::flush() {
+    std::lock_guard<std::mutex> flushLock(flushMutex);
+
+    PendingMap batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch.swap(pending);
+    }
+    if (batch.empty()) {
+        return true;
+    }
+
+    // Written in arrival order: the rowid order is what recency is rebuilt
+    // from after a restart
+    std::vector<MediaProgress> rows;
+    rows.reserve(batch.size());
+    for (const PendingUpdate* update : inOrder(batch)) {
+        rows.push_back(update->progress);
+    }
+
+    if (db.insertMediaMetadataBatch(rows) == 0) {
+        return true;
+    }
+
+    // Put the batch back, unless a newer update arrived in the meantime
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : batch) {
+        pending.emplace(entry.first, std::move(entry.second));
+    }
+    return false;
+}
+
+void ProgressStore::flushLoop() {
+    std::unique_lock<std::mutex> lock(stopMutex);
+    while (!stopCondition.wait_for(lock, flushInterval, [this] { return stopping; })) {
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef PROGRESSSTORE_H
+#define PROGRESSSTORE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "DatabaseHandler.h"
+#include "EpisodeIndex.h"
+
+// Authoritative in-memory watch progress. A profile's rows are loaded from
+// SQLite the first time it is read; updates to a profile nobody has read yet
+// only go to the write-behind queue and are replayed on top at that first
+// read. After that every read is served from memory. Profiles that are not
+// in the Profile table are never cached. Updates are written behind:
+// coalesced per (user, profile, media), keeping only the latest, and written
+// by a background thread in one transaction per interval. The destructor
+// flushes whatever is still pending.
+//
+// Each profile also keeps its media in update order, from which the
+// "continue watching" row is derived: unfinished media to resume and, for
+// finished episodes, the next one in the collection.
+class ProgressStore {
+public:
+    explicit ProgressStore(DatabaseHandler& dbHandler,
+        std::chrono::milliseconds flushInterval = std::chrono::milliseconds(5000));
+    ~ProgressStore();
+
+    ProgressStore(const ProgressStore&) = delete;
+    ProgressStore& operator=(const ProgressStore&) = delete;
+
+    void record(const MediaProgress& progress);
+
+    // {"mediaMetadata": [...]} for one profile, in the shape of the table rows
+    std::string serialize(const std::string& userID, const std::string& profileID);
+
+    // {"catalogVersion": v, "continueWatching": [...]}, most recent first and
+    // at most one entry per collection. catalogVersion identifies the episode
+    // list the next-episode lookups were resolved against.
+    std::string continueWatching(const std::string& userID, const std::string& profileID, long long catalogVersion);
+
+    // Drops a deleted profile: its cached rows and any updates not yet written
+    void forget(const std::string& userID, const std::string& profileID);
+
+    // Writes every pending update now. Returns false if the write failed;
+    // the updates stay pending and are retried on the next flush.
+    bool flush();
+
+private:
+    struct Profile {
+        std::map<std::string, MediaProgress> media;     // By media ID
+        std::vector<std::string> recent;                // Media IDs, last updated first
+        std::string json;                               // Cached body, empty when stale
+        std::string continueJson;                       // Same, for continueWatching
+        long long continueVersion = -1;                 // Catalog version it was built for
+    };
+
+    struct PendingUpdate {
+        unsigned long long sequence;    // Order of arrival, kept when written
+        MediaProgress progress;
+    };
+    using PendingMap = std::unordered_map<std::string, PendingUpdate>;
+
+    static std::vector<const PendingUpdate*> inOrder(const PendingMap& updates);
+    static std::string keyFor(const std::string& userID, const std::string& profileID);
+    static std::string keyFor(const MediaProgress& progress);
+    Profile& profileFor(const std::string& userID, const std::string& profileID);
+    std::shared_ptr<const EpisodeIndex> episodesFor(long long catalogVersion);
+    static void touch(Profile& profile, const MediaProgress& progress);
+    static std::string buildContinueWatching(const Profile& profile, const EpisodeIndex& episodes, long long catalogVersion);
+    void flushLoop();
+
+    DatabaseHandler& db;
+    const std::chrono::milliseconds flushInterval;
+
+    // Lock order: flushMutex, then mutex
+    std::mutex mutex;
+    std::unordered_map<std::string, std::unique_ptr<Profile>> profiles;     // Only ones in the Profile table
+    Profile missing;        // Read in place of profiles that do not exist; never updated
+    PendingMap pending;
+    unsigned long long nextSequence = 0;
+
+    std::mutex flushMutex;
+
+    std::mutex episodesMutex;
+    std::shared_ptr<const EpisodeIndex> episodes;
+    long long episodesVersion = -1;
+
+    std::mutex stopMutex;
+    std::condition_variable stopCondition;
+    bool stopping = false;
+    std::thread flusher;
+};
+
+#endif // PROGRESSSTORE_H
@@ -0,0 +1,98 @@
+#ifndef ROWMAPPING_H
+#define ROWMAPPING_H
+
+#include "CppSQLite3.h"
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Binds query columns to record fields at compile time. A record opts in by
+// specializing RowMapping with the tuple of its columns, in SELECT order:
+//
+//     template <> struct RowMapping<ProfileRecord> {
+//         static constexpr auto columns = std::make_tuple(
+//             column("profileID", &ProfileRecord::profileID),
+//             column("pictureID", &ProfileRecord::pictureID));
+//     };
+//
+// selectList<T>() spells the matching SELECT list and readRow<T>() copies
+// column i into the i-th field by index, so rows are read without any
+// per-row name lookups.
+
+template <typename Record, typename Field>
+struct Column {
+    const char* name;
+    Field Record::* member;
+};
+
+template <typename Record, typename Field>
+constexpr Column<Record, Field> column(const char* name, Field Record::* member) {
+    return Column<Record, Field>{ name, member };
+}
+
+template <typename Record>
+struct RowMapping;
+
+namespace rowmapping {
+
+    // NULL reads as the field's zero value, like the CppSQLite3 getters
+    inline void readField(const CppSQLite3Query& query, int index, std::string& field) {
+        field = query.getStringView(index);
+    }
+
+    inline void readField(const CppSQLite3Query& query, int index, int& field) {
+        field = query.getIntField(index);
+    }
+
+    inline void readField(const CppSQLite3Query& query, int index, long long& field) {
+        field = query.getInt64Field(index);
+    }
+
+    inline void readField(const CppSQLite3Query& query, int index, double& field) {
+        field = query.getDoubleField(index);
+    }
+
+}
+
+template <typename Record>
+constexpr int columnCount() {
+    return static_cast<int>(std::tuple_size<decltype(RowMapping<Record>::columns)>::value);
+}
+
+// "a, b, c" for the mapped columns; callers keep it in a static so the
+// statement cache sees the same SQL every time
+template <typename Record>
+std::string selectList() {
+    std::string list;
+    std::apply([&list](const auto&... columns) {
+        ((list += list.empty() ? "" : ", ", list += columns.name), ...);
+    }, RowMapping<Record>::columns);
+    return list;
+}
+
+template <typename Record>
+Record readRow(const CppSQLite3Query& query) {
+    Record record;
+    std::apply([&query, &record](const auto&... columns) {
+        int index = 0;
+        (rowmapping::readField(query, index++, record.*(columns.member)), ...);
+    }, RowMapping<Record>::columns);
+    return record;
+}
+
+template <typename Record>
+std::vector<Record> readRows(CppSQLite3Query& query) {
+    if (query.numFields() < columnCount<Record>()) {
+        throw std::runtime_error("Query returns fewer columns than the record maps");
+    }
+
+    std::vector<Record> rows;
+    while (!query.eof()) {
+        rows.push_back(readRow<Record>(query));
+        query.nextRow();
+    }
+    return rows;
+}
+
+#endif // ROWMAPPING_H
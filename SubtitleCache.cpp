@@ -0,0 +1,337 @@
+#include "SubtitleCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include "SubtitleConverter.h"
+namespace fs = std::filesystem;
+
+// How long a cached entry is trusted before its file is stat'ed again
+static const std::chrono::seconds REVALIDATE_INTERVAL(2);
+
+static const std::string UTF8_BOM = "\xEF\xBB\xBF";
+
+// Length of the valid UTF-8 sequence starting at data[i], or 0 if invalid
+static size_t utf8SequenceLength(const std::string& data, size_t i) {
+    unsigned char c = static_cast<unsigned char>(data[i]);
+    size_t len;
+    if (c < 0x80) return 1;
+    else if (c >= 0xC2 && c <= 0xDF) len = 2;
+    else if (c >= 0xE0 && c <= 0xEF) len = 3;
+    else if (c >= 0xF0 && c <= 0xF4) len = 4;
+    else return 0;
+
+    if (i + len > data.size()) return 0;
+    for (size_t k = 1; k < len; ++k) {
+        if ((static_cast<unsigned char>(data[i + k]) & 0xC0) != 0x80) return 0;
+    }
+
+    // Reject overlong and surrogate encodings
+    unsigned char c1 = static_cast<unsigned char>(data[i + 1]);
+    if (c == 0xE0 && c1 < 0xA0) return 0;
+    if (c == 0xED && c1 > 0x9F) return 0;
+    if (c == 0xF0 && c1 < 0x90) return 0;
+    if (c == 0xF4 && c1 > 0x8F) return 0;
+    return len;
+}
+
+static std::string computeETag(const std::string& body) {
+    // FNV-1a, good enough to tell versions of the same file apart
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : body) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    char buffer[24];
+    std::snprintf(buffer, sizeof(buffer), "\"%016llx\"", static_cast<unsigned long long>(hash));
+    return buffer;
+}
+
+// Parses "hh:mm:ss.ttt" or "mm:ss.ttt" into seconds, -1 on error
+static double parseTimestamp(const std::string& text) {
+    double seconds = 0.0;
+    size_t pos = 0;
+    int fields = 0;
+    while (pos <= text.size()) {
+        size_t colon = text.find(':', pos);
+        std::string part = text.substr(pos, colon == std::string::npos ? std::string::npos : colon - pos);
+        if (part.empty()) return -1.0;
+        char* end = nullptr;
+        double value = std::strtod(part.c_str(), &end);
+        if (end == part.c_str() || *end != '\0') return -1.0;
+        seconds = seconds * 60.0 + value;
+        ++fields;
+        if (colon == std::string::npos) break;
+        pos = colon + 1;
+    }
+    return (fields == 2 || fields == 3) ? seconds : -1.0;
+}
+
+// Reads the "start --> end [settings]" line of a cue block
+static bool parseTimingLine(const std::string& line, double& start, double& end) {
+    size_t arrow = line.find("-->");
+    if (arrow == std::string::npos) return false;
+
+    auto token = [&line](size_t from, size_t to) {
+        while (from < to && (line[from] == ' ' || line[from] == '\t')) ++from;
+        size_t stop = from;
+        while (stop < to && line[stop] != ' ' && line[stop] != '\t') ++stop;
+        return line.substr(from, stop - from);
+    };
+
+    start = parseTimestamp(token(0, arrow));
+    end = parseTimestamp(token(arrow + 3, line.size()));
+    return start >= 0.0 && end >= 0.0;
+}
+
+SubtitleCache::SubtitleCache(const std::string& chunksPath)
+    : chunksPath(chunksPath) {
+}
+
+std::string SubtitleCache::decodeText(const std::string& raw) {
+    size_t start = 0;
+    while (raw.compare(start, UTF8_BOM.size(), UTF8_BOM) == 0) {
+        start += UTF8_BOM.size();
+    }
+
+    std::string text;
+    text.reserve(raw.size() - start + 16);
+
+    for (size_t i = start; i < raw.size();) {
+        char c = raw[i];
+        if (c == '\r') {
+            // CRLF and lone CR both become LF
+            text += '\n';
+            i += (i + 1 < raw.size() && raw[i + 1] == '\n') ? 2 : 1;
+            continue;
+        }
+
+        size_t len = utf8SequenceLength(raw, i);
+        if (len > 0) {
+            text.append(raw, i, len);
+            i += len;
+        }
+        else {
+            // Not UTF-8: assume Latin-1, which is what most legacy subtitles are
+            unsigned char b = static_cast<unsigned char>(c);
+            text += static_cast<char>(0xC0 | (b >> 6));
+            text += static_cast<char>(0x80 | (b & 0x3F));
+            ++i;
+        }
+    }
+    return text;
+}
+
+std::string SubtitleCache::normalize(const std::string& raw) {
+    std::string text = decodeText(raw);
+
+    std::string result = UTF8_BOM;
+    if (text.compare(0, 6, "WEBVTT") != 0) {
+        result += "WEBVTT\n\n";
+    }
+    result += text;
+    if (result.back() != '\n') {
+        result += '\n';
+    }
+    return result;
+}
+
+static bool readFile(const fs::path& path, std::string& content) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+    content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+std::shared_ptr<const SubtitleCache::Entry> SubtitleCache::load(const fs::path& path) {
+    std::error_code ec;
+    auto entry = std::make_shared<Entry>();
+    entry->mtime = fs::last_write_time(path, ec);
+    if (ec) return nullptr;
+    entry->size = fs::file_size(path, ec);
+    if (ec) return nullptr;
+
+    std::string raw;
+    if (!readFile(path, raw)) return nullptr;
+
+    entry->body = normalize(raw);
+    entry->etag = computeETag(entry->body);
+    indexCues(*entry);
+    return entry;
+}
+
+void SubtitleCache::indexCues(Entry& entry) {
+    const std::string& body = entry.body;
+    size_t headerEnd = 0;
+    double maxEnd = 0.0;
+    bool first = true;
+
+    size_t pos = 0;
+    while (pos < body.size()) {
+        // Blocks are separated by one or more blank lines
+        while (pos < body.size() && body[pos] == '\n') ++pos;
+        if (pos >= body.size()) break;
+
+        size_t blockEnd = body.find("\n\n", pos);
+        if (blockEnd == std::string::npos) {
+            blockEnd = body.size();
+            while (blockEnd > pos && body[blockEnd - 1] == '\n') --blockEnd;
+        }
+
+        if (first) {
+            // The WEBVTT signature block
+            headerEnd = blockEnd;
+            first = false;
+            pos = blockEnd;
+            continue;
+        }
+
+        // The timing line is either the first line or follows a cue identifier
+        double start = 0.0, end = 0.0;
+        size_t lineEnd = body.find('\n', pos);
+        if (lineEnd == std::string::npos || lineEnd > blockEnd) lineEnd = blockEnd;
+        bool isCue = parseTimingLine(body.substr(pos, lineEnd - pos), start, end);
+        if (!isCue && lineEnd < blockEnd) {
+            size_t nextEnd = body.find('\n', lineEnd + 1);
+            if (nextEnd == std::string::npos || nextEnd > blockEnd) nextEnd = blockEnd;
+            isCue = parseTimingLine(body.substr(lineEnd + 1, nextEnd - lineEnd - 1), start, end);
+        }
+
+        if (isCue) {
+            maxEnd = std::max(maxEnd, end);
+            entry.cues.push_back(Cue{ start, end, maxEnd, pos, blockEnd - pos });
+        }
+        else if (entry.cues.empty()) {
+            // STYLE, REGION and NOTE blocks before the first cue belong to the header
+            headerEnd = blockEnd;
+        }
+        pos = blockEnd;
+    }
+
+    entry.header = body.substr(0, headerEnd) + "\n\n";
+}
+
+std::string SubtitleCache::window(const Entry& entry, double start, double end) {
+    // maxEnd never decreases, so it can be binary searched even when cues overlap
+    auto it = std::partition_point(entry.cues.begin(), entry.cues.end(),
+        [start](const Cue& cue) { return cue.maxEnd <= start; });
+
+    std::string result = entry.header;
+    for (; it != entry.cues.end() && it->start < end; ++it) {
+        if (it->end > start) {
+            result.append(entry.body, it->offset, it->length);
+            result += "\n\n";
+        }
+    }
+    return result;
+}
+
+std::string SubtitleCache::windowETag(const Entry& entry, double start, double end) {
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "-%g-%g\"", start, end);
+    return entry.etag.substr(0, entry.etag.size() - 1) + buffer;
+}
+
+void SubtitleCache::convertSidecar(const fs::path& vttPath) {
+    static const char* const sourceExtensions[] = { ".srt", ".ass", ".ssa" };
+
+    std::error_code ec;
+    auto vttTime = fs::last_write_time(vttPath, ec);
+    bool haveVtt = !ec;
+
+    for (const char* extension : sourceExtensions) {
+        fs::path source = vttPath;
+        source.replace_extension(extension);
+        auto sourceTime = fs::last_write_time(source, ec);
+        if (ec) continue;
+        if (haveVtt && vttTime >= sourceTime) return;
+
+        std::lock_guard<std::mutex> lock(convertMutex);
+
+        // Another request may have converted it while we waited
+        vttTime = fs::last_write_time(vttPath, ec);
+        if (!ec && vttTime >= sourceTime) return;
+
+        std::string raw;
+        if (!readFile(source, raw)) return;
+
+        std::string text = decodeText(raw);
+        std::string vtt = (source.extension() == ".srt") ? srtToVtt(text) : assToVtt(text);
+
+        // Write next to the source so the conversion survives restarts
+        fs::path tempPath = vttPath;
+        tempPath += ".tmp";
+        {
+            std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                std::cerr << "Failed to write converted subtitles: " << tempPath.string() << std::endl;
+                return;
+            }
+            out << normalize(vtt);
+        }
+        fs::rename(tempPath, vttPath, ec);
+        if (ec) {
+            std::cerr << "Failed to store converted subtitles: " << ec.message() << std::endl;
+            fs::remove(tempPath, ec);
+            return;
+        }
+        std::cout << "Converted " << source.string() << " to WebVTT" << std::endl;
+        return;
+    }
+}
+
+std::shared_ptr<const SubtitleCache::Entry> SubtitleCache::get(const std::string& mediaID, const std::string& language) {
+    // "fr" and "fr.vtt" both name the same track
+    fs::path path = fs::path(chunksPath) / mediaID / "subtitles" / language;
+    if (!path.has_extension()) {
+        path += ".vtt";
+    }
+    std::string key = path.string();
+    auto now = std::chrono::steady_clock::now();
+
+    std::shared_ptr<const Entry> cached;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = slots.find(key);
+        if (it != slots.end()) {
+            if (now - it->second.checkedAt < REVALIDATE_INTERVAL) {
+                return it->second.entry;
+            }
+            cached = it->second.entry;
+        }
+    }
+
+    if (path.extension() == ".vtt") {
+        convertSidecar(path);
+    }
+
+    // Cheap revalidation: only reload the content if size or mtime changed
+    std::error_code ec;
+    auto mtime = fs::last_write_time(path, ec);
+    auto size = ec ? 0 : fs::file_size(path, ec);
+
+    std::shared_ptr<const Entry> entry;
+    if (ec) {
+        entry = nullptr;
+    }
+    else if (cached && cached->mtime == mtime && cached->size == size) {
+        entry = cached;
+    }
+    else {
+        entry = load(path);
+        if (!entry) {
+            std::cerr << "Failed to load subtitles: " << key << std::endl;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (entry) {
+        slots[key] = Slot{ entry, now };
+    }
+    else {
+        slots.erase(key);
+    }
+    return entry;
+}
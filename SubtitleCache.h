@@ -0,0 +1,68 @@
+#ifndef SUBTITLECACHE_H
+#define SUBTITLECACHE_H
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Keeps every requested VTT file in memory, normalized to UTF-8 WebVTT
+// (single BOM, LF line endings). Entries are immutable and shared, and are
+// reloaded when the file on disk changes. Cue timings are indexed on load
+// so a time window can be cut out without reparsing the file. SRT and ASS
+// sidecars without a matching .vtt are converted on first request and the
+// result is written back next to them.
+class SubtitleCache {
+public:
+    struct Cue {
+        double start;
+        double end;
+        double maxEnd;      // Largest end time of this and all earlier cues
+        size_t offset;      // Byte range of the cue block inside body
+        size_t length;
+    };
+
+    struct Entry {
+        std::string body;
+        std::string etag;
+        std::string header; // WEBVTT line plus any STYLE/REGION/NOTE blocks
+        std::vector<Cue> cues;
+        std::filesystem::file_time_type mtime;
+        std::uintmax_t size = 0;
+    };
+
+    explicit SubtitleCache(const std::string& chunksPath);
+
+    // Returns nullptr if the subtitle file does not exist.
+    std::shared_ptr<const Entry> get(const std::string& mediaID, const std::string& language);
+
+    // Strips BOMs, unifies line endings and repairs the encoding to UTF-8
+    static std::string decodeText(const std::string& raw);
+    static std::string normalize(const std::string& raw);
+
+    // Builds a standalone WebVTT document with the cues overlapping [start, end)
+    static std::string window(const Entry& entry, double start, double end);
+    static std::string windowETag(const Entry& entry, double start, double end);
+
+private:
+    struct Slot {
+        std::shared_ptr<const Entry> entry;
+        std::chrono::steady_clock::time_point checkedAt;
+    };
+
+    std::shared_ptr<const Entry> load(const std::filesystem::path& path);
+    static void indexCues(Entry& entry);
+    void convertSidecar(const std::filesystem::path& vttPath);
+
+    const std::string chunksPath;
+    std::shared_mutex mutex;
+    std::mutex convertMutex;
+    std::unordered_map<std::string, Slot> slots;
+};
+
+#endif // SUBTITLECACHE_H
@@ -0,0 +1,260 @@
+#include "SubtitleConverter.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+    struct Cue {
+        double start;
+        double end;
+        std::string text;
+    };
+
+    // Calls fn(line) for every line of text, without copying the input
+    template <typename Fn>
+    void forEachLine(const std::string& text, Fn fn) {
+        size_t pos = 0;
+        while (pos < text.size()) {
+            size_t end = text.find('\n', pos);
+            if (end == std::string::npos) end = text.size();
+            fn(text.data() + pos, end - pos);
+            pos = end + 1;
+        }
+    }
+
+    std::string trim(const char* data, size_t len) {
+        size_t begin = 0;
+        while (begin < len && (data[begin] == ' ' || data[begin] == '\t')) ++begin;
+        while (len > begin && (data[len - 1] == ' ' || data[len - 1] == '\t')) --len;
+        return std::string(data + begin, len - begin);
+    }
+
+    // Parses "h:mm:ss,mmm", "h:mm:ss.cc" and similar clock values into seconds
+    double parseClock(const std::string& text) {
+        double seconds = 0.0;
+        int fields = 0;
+        const char* p = text.c_str();
+        while (*p) {
+            char* end = nullptr;
+            double value;
+            if (fields == 2 || !std::strchr(p, ':')) {
+                // Last field may use a comma as the decimal separator
+                std::string last(p);
+                std::replace(last.begin(), last.end(), ',', '.');
+                value = std::strtod(last.c_str(), &end);
+                if (end == last.c_str()) return -1.0;
+                seconds = seconds * 60.0 + value;
+                return fields >= 1 ? seconds : -1.0;
+            }
+            value = std::strtod(p, &end);
+            if (end == p || *end != ':') return -1.0;
+            seconds = seconds * 60.0 + value;
+            ++fields;
+            p = end + 1;
+        }
+        return -1.0;
+    }
+
+    std::string formatTimestamp(double seconds) {
+        long long ms = static_cast<long long>(seconds * 1000.0 + 0.5);
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%02lld:%02lld:%02lld.%03lld",
+            ms / 3600000, (ms / 60000) % 60, (ms / 1000) % 60, ms % 1000);
+        return buffer;
+    }
+
+    bool isAllowedTag(const std::string& text, size_t pos, size_t& tagEnd) {
+        static const char* const tags[] = { "<i>", "</i>", "<b>", "</b>", "<u>", "</u>" };
+        for (const char* tag : tags) {
+            size_t len = std::char_traits<char>::length(tag);
+            if (text.compare(pos, len, tag) == 0) {
+                tagEnd = pos + len;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Makes cue text safe for WebVTT: keeps i/b/u tags, drops other markup
+    // (font tags, {\an8} overrides) and escapes the rest.
+    std::string escapeCueText(const std::string& text) {
+        std::string out;
+        out.reserve(text.size());
+        for (size_t i = 0; i < text.size();) {
+            char c = text[i];
+            size_t tagEnd;
+            if (c == '<' && isAllowedTag(text, i, tagEnd)) {
+                out.append(text, i, tagEnd - i);
+                i = tagEnd;
+            }
+            else if (c == '<' && text.find('>', i) != std::string::npos &&
+                (i + 1 < text.size() && (std::isalpha(static_cast<unsigned char>(text[i + 1])) || text[i + 1] == '/'))) {
+                i = text.find('>', i) + 1;
+            }
+            else if (c == '{' && i + 1 < text.size() && text[i + 1] == '\\' && text.find('}', i) != std::string::npos) {
+                i = text.find('}', i) + 1;
+            }
+            else if (c == '<') {
+                out += "&lt;";
+                ++i;
+            }
+            else if (c == '>') {
+                out += "&gt;";
+                ++i;
+            }
+            else if (c == '&') {
+                out += "&amp;";
+                ++i;
+            }
+            else {
+                out += c;
+                ++i;
+            }
+        }
+        return out;
+    }
+
+    std::string writeVtt(const std::vector<Cue>& cues) {
+        std::string vtt = "WEBVTT\n\n";
+        for (const Cue& cue : cues) {
+            vtt += formatTimestamp(cue.start);
+            vtt += " --> ";
+            vtt += formatTimestamp(cue.end);
+            vtt += '\n';
+            vtt += cue.text;
+            vtt += "\n\n";
+        }
+        return vtt;
+    }
+
+}
+
+std::string srtToVtt(const std::string& srt) {
+    std::vector<Cue> cues;
+    Cue current{ -1.0, -1.0, "" };
+    bool inCue = false;
+
+    auto flush = [&]() {
+        if (inCue && !current.text.empty()) {
+            cues.push_back(current);
+        }
+        current = Cue{ -1.0, -1.0, "" };
+        inCue = false;
+    };
+
+    forEachLine(srt, [&](const char* data, size_t len) {
+        std::string line = trim(data, len);
+        if (line.empty()) {
+            flush();
+            return;
+        }
+
+        size_t arrow = line.find("-->");
+        if (!inCue && arrow != std::string::npos) {
+            // Strip SRT position hints ("X1:... Y2:...") after the end time
+            std::string endText = trim(line.data() + arrow + 3, line.size() - arrow - 3);
+            endText = endText.substr(0, endText.find(' '));
+            current.start = parseClock(trim(line.data(), arrow));
+            current.end = parseClock(endText);
+            inCue = current.start >= 0.0 && current.end >= 0.0;
+            return;
+        }
+
+        if (inCue) {
+            if (!current.text.empty()) current.text += '\n';
+            current.text += escapeCueText(line);
+        }
+        // Anything else outside a cue is the numeric counter, which WebVTT does not need
+        });
+    flush();
+
+    return writeVtt(cues);
+}
+
+std::string assToVtt(const std::string& ass) {
+    std::vector<Cue> cues;
+    bool inEvents = false;
+    std::vector<std::string> format = { "Layer", "Start", "End", "Style", "Name",
+        "MarginL", "MarginR", "MarginV", "Effect", "Text" };
+
+    forEachLine(ass, [&](const char* data, size_t len) {
+        std::string line = trim(data, len);
+        if (line.empty() || line[0] == ';') return;
+
+        if (line[0] == '[') {
+            inEvents = (line == "[Events]");
+            return;
+        }
+        if (!inEvents) return;
+
+        if (line.compare(0, 7, "Format:") == 0) {
+            format.clear();
+            std::string fields = line.substr(7);
+            size_t pos = 0;
+            while (pos <= fields.size()) {
+                size_t comma = fields.find(',', pos);
+                if (comma == std::string::npos) comma = fields.size();
+                format.push_back(trim(fields.data() + pos, comma - pos));
+                pos = comma + 1;
+            }
+            return;
+        }
+        if (line.compare(0, 9, "Dialogue:") != 0) return;
+
+        // Text is the last field and may itself contain commas
+        std::string start, end, text;
+        size_t pos = 9;
+        for (size_t field = 0; field < format.size(); ++field) {
+            size_t comma = (field + 1 == format.size()) ? line.size() : line.find(',', pos);
+            if (comma == std::string::npos) return;
+            std::string value = (field + 1 == format.size())
+                ? line.substr(pos)
+                : trim(line.data() + pos, comma - pos);
+            if (format[field] == "Start") start = value;
+            else if (format[field] == "End") end = value;
+            else if (format[field] == "Text") text = value;
+            pos = comma + 1;
+        }
+
+        Cue cue{ parseClock(start), parseClock(end), "" };
+        if (cue.start < 0.0 || cue.end < 0.0) return;
+
+        // Resolve ASS escapes before the generic markup clean-up
+        std::string plain;
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] == '\\' && i + 1 < text.size() && (text[i + 1] == 'N' || text[i + 1] == 'n')) {
+                // A blank line would end the cue early in WebVTT
+                if (!plain.empty() && plain.back() != '\n') plain += '\n';
+                ++i;
+            }
+            else if (text[i] == '\\' && i + 1 < text.size() && text[i + 1] == 'h') {
+                plain += ' ';
+                ++i;
+            }
+            else if (text[i] == '{') {
+                size_t close = text.find('}', i);
+                if (close == std::string::npos) break;
+                i = close;
+            }
+            else {
+                plain += text[i];
+            }
+        }
+
+        cue.text = escapeCueText(plain);
+        while (!cue.text.empty() && cue.text.back() == '\n') cue.text.pop_back();
+        if (!cue.text.empty()) {
+            cues.push_back(std::move(cue));
+        }
+        });
+
+    // Dialogue lines are not required to be in time order
+    std::stable_sort(cues.begin(), cues.end(),
+        [](const Cue& a, const Cue& b) { return a.start < b.start; });
+
+    return writeVtt(cues);
+}
@@ -0,0 +1,11 @@
+#ifndef SUBTITLECONVERTER_H
+#define SUBTITLECONVERTER_H
+
+#include <string>
+
+// Single-pass converters from sidecar subtitle formats to WebVTT.
+// Input must already be UTF-8 with LF line endings; output has no BOM.
+std::string srtToVtt(const std::string& srt);
+std::string assToVtt(const std::string& ass);
+
+#endif // SUBTITLECONVERTER_H
@@ -0,0 +1,224 @@
+// Entry point of the TestDB configuration: a standalone harness that checks
+// per-profile watch progress stays isolated under parallel load. Every
+// thread owns one (user, profile), reads its history over and over while
+// writing to it, and fails if it ever sees a row that belongs to someone
+// else. Profile names repeat across users, so a mix-up by either key shows.
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "DatabaseHandler.h"
+#include "ProgressStore.h"
+using json = nlohmann::json;
+
+static const int users = 2;
+static const int profilesPerUser = 4;
+static const int rounds = 200;
+
+struct Owner {
+    std::string userID;
+    std::string profileID;
+    int media = 0;      // Rows seeded for this profile; each owner has a different count
+};
+
+static std::mutex reportMutex;
+static std::atomic<int> failures{ 0 };
+
+static void fail(const Owner& owner, const std::string& message) {
+    std::lock_guard<std::mutex> lock(reportMutex);
+    if (++failures <= 20) {
+        std::cerr << "FAIL " << owner.userID << "/" << owner.profileID << ": " << message << std::endl;
+    }
+}
+
+// The tables from Init/init.py that watch progress touches
+static void createDatabase(const std::string& path, const std::vector<Owner>& owners) {
+    for (const char* suffix : { "", "-wal", "-shm" }) {
+        std::filesystem::remove(path + suffix);
+    }
+
+    CppSQLite3DB db;
+    db.open(path.c_str());
+    db.execDML(R"(
+        CREATE TABLE Media (
+            ID TEXT PRIMARY KEY,
+            title TEXT NOT NULL,
+            year TEXT,
+            description TEXT,
+            producer TEXT,
+            rating REAL,
+            season INTEGER,
+            episode INTEGER,
+            resolution TEXT NOT NULL,
+            image_path TEXT,
+            genres TEXT,
+            type TEXT NOT NULL,
+            collection_id TEXT
+        );
+        CREATE TABLE Collection (
+            ID TEXT PRIMARY KEY,
+            collection_title TEXT NOT NULL,
+            collection_description TEXT,
+            collection_rating REAL,
+            collection_type TEXT NOT NULL,
+            genres TEXT,
+            producer TEXT,
+            image_path TEXT
+        );
+        CREATE TABLE User (ID TEXT PRIMARY KEY, password TEXT NOT NULL);
+        CREATE TABLE Profile (
+            profileID TEXT,
+            userID TEXT,
+            pictureID TEXT,
+            UNIQUE (userID, profileID)
+        );
+        CREATE TABLE mediaMetadata (
+            userID TEXT,
+            profileID TEXT,
+            mediaID TEXT,
+            percentage_watched REAL,
+            language_chosen TEXT,
+            subtitles_chosen TEXT,
+            PRIMARY KEY (userID, profileID, mediaID)
+        );
+    )");
+
+    db.execDML("BEGIN;");
+    int mostMedia = 0;
+    for (const Owner& owner : owners) {
+        mostMedia = std::max(mostMedia, owner.media);
+    }
+    for (int i = 0; i < mostMedia; i++) {
+        CppSQLite3Statement media = db.compileStatement(
+            "INSERT INTO Media (ID, title, resolution, type) VALUES (?, ?, 'HD', 'movie');");
+        std::string id = "m" + std::to_string(i);
+        media.bind(1, id.c_str());
+        media.bind(2, id.c_str());
+        media.execDML();
+    }
+    for (int u = 0; u < users; u++) {
+        std::string userID = "u" + std::to_string(u);
+        CppSQLite3Statement user = db.compileStatement("INSERT INTO User (ID, password) VALUES (?, 'x');");
+        user.bind(1, userID.c_str());
+        user.execDML();
+    }
+    for (const Owner& owner : owners) {
+        CppSQLite3Statement profile = db.compileStatement("INSERT INTO Profile (profileID, userID, pictureID) VALUES (?, ?, '0');");
+        profile.bind(1, owner.profileID.c_str());
+        profile.bind(2, owner.userID.c_str());
+        profile.execDML();
+
+        for (int i = 0; i < owner.media; i++) {
+            CppSQLite3Statement row = db.compileStatement(
+                "INSERT INTO mediaMetadata VALUES (?, ?, ?, 0, 'en', 'none');");
+            std::string mediaID = "m" + std::to_string(i);
+            row.bind(1, owner.userID.c_str());
+            row.bind(2, owner.profileID.c_str());
+            row.bind(3, mediaID.c_str());
+            row.execDML();
+        }
+    }
+    db.execDML("COMMIT;");
+}
+
+static void checkRows(const Owner& owner, const std::string& source, const json& rows) {
+    if (!rows.is_array()) {
+        fail(owner, source + ": no mediaMetadata array");
+        return;
+    }
+    if (static_cast<int>(rows.size()) != owner.media) {
+        fail(owner, source + ": " + std::to_string(rows.size()) + " rows, expected " + std::to_string(owner.media));
+    }
+    for (const auto& row : rows) {
+        if (row.value("userID", "") != owner.userID || row.value("profileID", "") != owner.profileID) {
+            fail(owner, source + ": saw a row of " + row.value("userID", "?") + "/" + row.value("profileID", "?"));
+            return;
+        }
+    }
+}
+
+static void checkRows(const Owner& owner, const std::string& source, const std::vector<MediaProgress>& rows) {
+    if (static_cast<int>(rows.size()) != owner.media) {
+        fail(owner, source + ": " + std::to_string(rows.size()) + " rows, expected " + std::to_string(owner.media));
+    }
+    for (const auto& row : rows) {
+        if (row.userID != owner.userID || row.profileID != owner.profileID) {
+            fail(owner, source + ": saw a row of " + row.userID + "/" + row.profileID);
+            return;
+        }
+    }
+}
+
+static void run(DatabaseHandler& db, ProgressStore& progress, const Owner& owner) {
+    for (int round = 0; round < rounds; round++) {
+        // Rewrite one of our own rows so cached JSON is dropped and the
+        // flusher writes while other threads read
+        MediaProgress update;
+        update.userID = owner.userID;
+        update.profileID = owner.profileID;
+        update.mediaID = "m" + std::to_string(round % owner.media);
+        update.percentageWatched = round;
+        update.languageChosen = "en";
+        update.subtitlesChosen = "none";
+        progress.record(update);
+
+        try {
+            checkRows(owner, "progress", json::parse(progress.serialize(owner.userID, owner.profileID))["mediaMetadata"]);
+            checkRows(owner, "database", db.async([&owner](DatabaseHandler& handler) {
+                return handler.getMediaMetadata(owner.userID, owner.profileID);
+            }).get());
+        }
+        catch (const std::exception& e) {
+            fail(owner, std::string("threw: ") + e.what());
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string path = argc > 1 ? argv[1] : "testdb.db";
+
+    std::vector<Owner> owners;
+    for (int u = 0; u < users; u++) {
+        for (int p = 0; p < profilesPerUser; p++) {
+            owners.push_back({ "u" + std::to_string(u), "p" + std::to_string(p), 3 + static_cast<int>(owners.size()) });
+        }
+    }
+
+    try {
+        createDatabase(path, owners);
+
+        DatabaseHandler db(path);
+        {
+            ProgressStore progress(db, std::chrono::milliseconds(10));
+
+            std::vector<std::thread> threads;
+            for (const Owner& owner : owners) {
+                threads.emplace_back(run, std::ref(db), std::ref(progress), std::cref(owner));
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+
+        // The store flushed on destruction; the table must agree
+        for (const Owner& owner : owners) {
+            checkRows(owner, "after flush", db.getMediaMetadata(owner.userID, owner.profileID));
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "FAIL setup: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (failures > 0) {
+        std::cerr << failures << " isolation failures" << std::endl;
+        return 1;
+    }
+    std::cout << "Profile isolation: " << owners.size() << " threads x " << rounds << " rounds OK" << std::endl;
+    return 0;
+}
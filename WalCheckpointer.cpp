@@ -0,0 +1,102 @@
+#include "WalCheckpointer.h"
+#include <filesystem>
+#include <iostream>
+
+WalCheckpointer::WalCheckpointer(const std::string& dbPath, const CheckpointPolicy& policy, const PragmaProfile& pragmas)
+    : walPath(dbPath + "-wal"), policy(policy) {
+    db.open(dbPath.c_str(), SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX);
+    db.setBusyTimeout(pragmas.busyTimeoutMs);
+    // A checkpoint that empties the log truncates the file to this limit
+    std::string limitSql = "PRAGMA journal_size_limit=" + std::to_string(pragmas.journalSizeLimit) + ";";
+    db.execDML(limitSql.c_str());
+    // A connection only finds the WAL on its first read; until then every
+    // checkpoint reports -1 frames and does nothing
+    db.execScalar("SELECT count(*) FROM sqlite_master;");
+    pageSize = db.execScalar("PRAGMA page_size;");
+    checkpointer = std::thread(&WalCheckpointer::checkpointLoop, this);
+}
+
+WalCheckpointer::~WalCheckpointer() {
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (checkpointer.joinable()) {
+        checkpointer.join();
+    }
+}
+
+int WalCheckpointer::onCommit(void* self, sqlite3*, const char*, int pages) {
+    auto* checkpointer = static_cast<WalCheckpointer*>(self);
+    checkpointer->walPages.store(pages);
+    checkpointer->committed.store(true);
+
+    // Runs on the writer inside its commit, so only flag the work
+    if (pages - checkpointer->backfilled.load() >= checkpointer->policy.walPages) {
+        {
+            std::lock_guard<std::mutex> lock(checkpointer->stopMutex);
+            checkpointer->due = true;
+        }
+        checkpointer->wake.notify_one();
+    }
+    return SQLITE_OK;
+}
+
+CheckpointStats WalCheckpointer::stats() const {
+    CheckpointStats stats;
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats = totals;
+    }
+    stats.walPages = walPages.load();
+    stats.walBytes = static_cast<long long>(stats.walPages) * pageSize;
+
+    std::error_code ec;
+    auto size = std::filesystem::file_size(walPath, ec);
+    stats.walFileBytes = ec ? 0 : static_cast<long long>(size);
+    return stats;
+}
+
+void WalCheckpointer::checkpoint() {
+    int logFrames = 0;
+    int checkpointed = 0;
+    committed.store(false);
+    auto start = std::chrono::steady_clock::now();
+    try {
+        db.walCheckpoint(SQLITE_CHECKPOINT_PASSIVE, logFrames, checkpointed);
+    }
+    catch (const CppSQLite3Exception& e) {
+        std::cerr << "WAL checkpoint failed: " << e.errorMessage() << std::endl;
+        return;
+    }
+    double durationMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // Once every frame is copied the next commit starts the WAL over
+    backfilled.store(checkpointed >= logFrames ? 0 : checkpointed);
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+    ++totals.checkpoints;
+    totals.lastDurationMs = durationMs;
+    if (durationMs > totals.maxDurationMs) {
+        totals.maxDurationMs = durationMs;
+    }
+}
+
+void WalCheckpointer::checkpointLoop() {
+    std::unique_lock<std::mutex> lock(stopMutex);
+    while (!stopping) {
+        wake.wait_for(lock, policy.interval, [this] { return stopping || due; });
+        if (stopping) {
+            break;
+        }
+        // On a timeout, only when something was committed since the last pass
+        bool run = due || committed.load();
+        due = false;
+        if (run) {
+            lock.unlock();
+            checkpoint();
+            lock.lock();
+        }
+    }
+}
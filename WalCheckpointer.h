@@ -0,0 +1,70 @@
+#ifndef WALCHECKPOINTER_H
+#define WALCHECKPOINTER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "ConnectionPool.h"
+#include "CppSQLite3.h"
+
+// When the WAL is copied back into the database file
+struct CheckpointPolicy {
+    int walPages = 1000;    // Once this many pages were added since the last checkpoint
+    std::chrono::milliseconds interval{ 30000 };    // Or this often while the WAL has new pages
+};
+
+struct CheckpointStats {
+    unsigned long long checkpoints = 0;
+    double lastDurationMs = 0.0;
+    double maxDurationMs = 0.0;
+    int walPages = 0;           // Frames in the WAL after the last commit
+    long long walBytes = 0;     // Those frames' pages, the live size of the log
+    long long walFileBytes = 0; // Size of the -wal file; PASSIVE checkpoints never shrink it
+};
+
+// Runs PASSIVE checkpoints on its own connection, so they neither block the
+// writer nor wait for readers. The writer connection reports every commit
+// through onCommit, installed with CppSQLite3DB::setWalHook.
+class WalCheckpointer {
+public:
+    // The checkpointing connection takes the busy timeout and WAL size limit
+    // from pragmas
+    WalCheckpointer(const std::string& dbPath, const CheckpointPolicy& policy = CheckpointPolicy(),
+        const PragmaProfile& pragmas = PragmaProfile());
+    ~WalCheckpointer();
+
+    WalCheckpointer(const WalCheckpointer&) = delete;
+    WalCheckpointer& operator=(const WalCheckpointer&) = delete;
+
+    // sqlite3_wal_hook callback; self is the WalCheckpointer
+    static int onCommit(void* self, sqlite3* db, const char* dbName, int pages);
+
+    CheckpointStats stats() const;
+
+private:
+    void checkpoint();
+    void checkpointLoop();
+
+    const std::string walPath;
+    const CheckpointPolicy policy;
+    CppSQLite3DB db;
+
+    int pageSize = 0;
+    std::atomic<int> walPages{ 0 };
+    std::atomic<int> backfilled{ 0 };   // Frames already in the database file
+    std::atomic<bool> committed{ false };   // Since the last checkpoint
+
+    mutable std::mutex statsMutex;
+    CheckpointStats totals;
+
+    std::mutex stopMutex;
+    std::condition_variable wake;
+    bool due = false;
+    bool stopping = false;
+    std::thread checkpointer;
+};
+
+#endif // WALCHECKPOINTER_H
@@ -1,4 +1,8 @@
 #include "api.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <vector>
 #include <string>
@@ -61,8 +65,10 @@ bool API::validateRequest(const crow::request& req, std::string& userID) {
     return validateJWT(token, userID);
 }
 
-API::API(DatabaseHandler& dbHandler, const std::string& coversPath, const std::string& chunksPath, const std::string& domain)
-    : db(dbHandler), coversPath(coversPath), chunksPath(chunksPath), domain(domain) {
+API::API(DatabaseHandler& dbHandler, const std::string& coversPath, const std::string& chunksPath, const std::string& domain,
+    std::chrono::milliseconds progressFlushInterval)
+    : db(dbHandler), coversPath(coversPath), chunksPath(chunksPath), domain(domain), subtitleCache(chunksPath), coverStore(coversPath), catalog(dbHandler),
+    progressStore(dbHandler, progressFlushInterval) {
     loasPasswords();
 }
 
@@ -106,47 +112,72 @@ void API::run(int port) {
         return getCoverImage(req, id);
             });
 
-    CROW_ROUTE(app, "/media/data").methods(crow::HTTPMethod::GET)([this](const crow::request& req) {
-        return getMediaData(req);
+    // Route to fetch many covers in a single framed response
+    CROW_ROUTE(app, "/covers/bundle").methods(crow::HTTPMethod::POST)([this](const crow::request& req) {
+        return getCoverBundle(req);
+        });
+
+    CROW_ROUTE(app, "/media/data").methods(crow::HTTPMethod::GET)([this](const crow::request& req, crow::response& res) {
+        // The pre-serialized snapshot needs no SQL; pages and deltas do
+        if (!catalogNeedsDatabase(req)) {
+            res = getMediaData(req);
+            res.end();
+            return;
+        }
+        respondFromDatabase(res, [this, &req] { return getMediaData(req); });
         });
 
     // Route to get user-specific metadata JSON
-    CROW_ROUTE(app, "/user/metadata").methods(crow::HTTPMethod::POST)([this](const crow::request& req) {
-        return getMediaMetadata(req);
+    CROW_ROUTE(app, "/user/metadata").methods(crow::HTTPMethod::POST)([this](const crow::request& req, crow::response& res) {
+        respondFromDatabase(res, [this, &req] { return getMediaMetadata(req); });
         });
 
 
     // Route to add a new profile
-    CROW_ROUTE(app, "/profile/add").methods(crow::HTTPMethod::POST)([this](const crow::request& req) {
-        return addProfile(req);
+    CROW_ROUTE(app, "/profile/add").methods(crow::HTTPMethod::POST)([this](const crow::request& req, crow::response& res) {
+        respondFromDatabase(res, [this, &req] { return addProfile(req); });
         });
 
     // Route to delete a profile
-    CROW_ROUTE(app, "/profile/delete").methods(crow::HTTPMethod::POST)([this](const crow::request& req) {
-        return deleteProfile(req);
+    CROW_ROUTE(app, "/profile/delete").methods(crow::HTTPMethod::POST)([this](const crow::request& req, crow::response& res) {
+        respondFromDatabase(res, [this, &req] { return deleteProfile(req); });
         });
 
     // Route to list all profiles for a specific user
-    CROW_ROUTE(app, "/profile/list").methods(crow::HTTPMethod::POST)([this](const crow::request& req) {
-        return listProfiles(req);
+    CROW_ROUTE(app, "/profile/list").methods(crow::HTTPMethod::POST)([this](const crow::request& req, crow::response& res) {
+        respondFromDatabase(res, [this, &req] { return listProfiles(req); });
         });
 
     CROW_ROUTE(app, "/download/media_data").methods(crow::HTTPMethod::POST)
-        ([this](const crow::request& req){
-        return downloadMediaData(req);
+        ([this](const crow::request& req, crow::response& res) {
+        if (!catalogNeedsDatabase(req)) {
+            res = downloadMediaData(req);
+            res.end();
+            return;
+        }
+        respondFromDatabase(res, [this, &req] { return downloadMediaData(req); });
             });
 
     // Route to serve the pre-generated user metadata JSON file
     CROW_ROUTE(app, "/download/media_metadata").methods(crow::HTTPMethod::POST)
-        ([this](const crow::request& req) {
-        
-        return downloadMediaMetadata(req);
+        ([this](const crow::request& req, crow::response& res) {
+        respondFromDatabase(res, [this, &req] { return downloadMediaMetadata(req); });
             });
 
     CROW_ROUTE(app, "/update_media_metadata").methods(crow::HTTPMethod::POST)([this](const crow::request& req) {
         return updateMediaMetadata(req);
         });
 
+    // Route to get the ready-made "continue watching" row of a profile
+    CROW_ROUTE(app, "/user/continue_watching").methods(crow::HTTPMethod::POST)([this](const crow::request& req, crow::response& res) {
+        respondFromDatabase(res, [this, &req] { return continueWatching(req); });
+        });
+
+    // Route to read server counters (statement cache hit rate)
+    CROW_ROUTE(app, "/server/stats").methods(crow::HTTPMethod::GET)([this](const crow::request& req) {
+        return serverStats(req);
+        });
+
     app.bindaddr("0.0.0.0").port(port).multithreaded().run();
 }
 
@@ -193,21 +224,16 @@ crow::response API::downloadMediaMetadata(const crow::request& req) {
     std::string profileID = x["profileID"].s();
 
     
-    // Generate user metadata JSON if needed
-    db.generateMediaMetadataJson(userID, profileID);
-
-    std::ifstream file("media_metadata.json");
-    if (!file.is_open()) {
-        return crow::response(500, "Failed to open media_metadata.json");
+    try {
+        // Served from memory; SQLite is only read the first time a profile asks
+        crow::response res(progressStore.serialize(userID, profileID));
+        res.add_header("Content-Type", "application/json");
+        return res;
+    }
+    catch (const CppSQLite3Exception& e) {
+        std::cerr << "Failed to read media metadata: " << e.errorMessage() << std::endl;
+        return crow::response(500, "Failed to read media metadata");
     }
-
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    file.close();
-
-    crow::response res(buffer.str());
-    res.add_header("Content-Type", "application/json");
-    return res;
 }
 
 
@@ -218,18 +244,133 @@ crow::response API::downloadMediaData(const crow::request& req) {
         return crow::response(401, "Invalid authentication");
     }
 
-    db.generateMediaDataJson();
-    std::ifstream file("media_data.json");
-    if (!file.is_open()) {
-        return crow::response(500, "Failed to open media_data.json");
+    return catalogResponse(req);
+}
+
+bool API::catalogNeedsDatabase(const crow::request& req) {
+    return req.url_params.get("since") || req.url_params.get("limit") || req.url_params.get("cursor") ||
+        req.url_params.get("fields") || req.url_params.get("collection") || req.url_params.get("genre");
+}
+
+void API::respondFromDatabase(crow::response& res, std::function<crow::response()> handler) {
+    // crow keeps req and res alive until res.end(), so the handler can keep
+    // reading the request from the database thread
+    bool queued = db.post(
+        [handler = std::move(handler)](DatabaseHandler&) { return handler(); },
+        [&res](std::future<crow::response> result) {
+            try {
+                res = result.get();
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Request failed on a database thread: " << e.what() << std::endl;
+                res = crow::response(500, "Internal server error");
+            }
+            res.end();
+        });
+
+    if (!queued) {
+        res = crow::response(503, "Database busy");
+        res.set_header("Retry-After", "1");
+        res.end();
+    }
+}
+
+crow::response API::catalogResponse(const crow::request& req) {
+    // ?since=<version> asks only for what changed after that version
+    const char* sinceParam = req.url_params.get("since");
+    if (sinceParam) {
+        long long since = std::atoll(sinceParam);
+        bool full = false;
+        std::string body;
+        try {
+            body = catalog.changesSince(since, full);
+        }
+        catch (const std::exception& e) {
+            return crow::response(500, std::string("Failed to compute catalog changes: ") + e.what());
+        }
+
+        crow::response res(body);
+        res.add_header("Content-Type", "application/json");
+        res.add_header("X-Catalog-Sync", full ? "full" : "delta");
+        return res;
+    }
+
+    // Paged, projected, collection- or genre-scoped reads go to the database
+    const char* limitParam = req.url_params.get("limit");
+    const char* cursorParam = req.url_params.get("cursor");
+    const char* fieldsParam = req.url_params.get("fields");
+    const char* collectionParam = req.url_params.get("collection");
+    const char* genreParam = req.url_params.get("genre");
+    if (limitParam || cursorParam || fieldsParam || collectionParam || genreParam) {
+        CatalogPageQuery page;
+        if (limitParam) {
+            page.limit = std::clamp(std::atoi(limitParam), 1, 1000);
+        }
+        if (cursorParam) {
+            page.cursor = cursorParam;
+        }
+        if (collectionParam) {
+            page.collectionID = collectionParam;
+        }
+        if (genreParam) {
+            page.genre = genreParam;
+        }
+        if (fieldsParam) {
+            std::stringstream fields(fieldsParam);
+            std::string field;
+            while (std::getline(fields, field, ',')) {
+                if (!field.empty()) {
+                    page.fields.push_back(field);
+                }
+            }
+        }
+
+        try {
+            crow::response res(db.serializeMediaPage(page, catalog.current()->version));
+            res.add_header("Content-Type", "application/json");
+            return res;
+        }
+        catch (const std::exception& e) {
+            return crow::response(500, std::string("Failed to read catalog page: ") + e.what());
+        }
     }
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    file.close();
+    // The catalog is pre-serialized in every encoding; serving it is a
+    // pointer load and a send
+    auto snapshot = catalog.current();
+
+    std::string accept = req.get_header_value("Accept");
+    const std::string* body = &snapshot->encodings.json;
+    std::string contentType = "application/json";
+    std::string etag = snapshot->etag;
+    std::string encoding;
+    if (accept.find("application/cbor") != std::string::npos) {
+        body = &snapshot->encodings.cbor;
+        contentType = "application/cbor";
+        encoding = "-cbor";
+    }
+    else if (accept.find("msgpack") != std::string::npos) {
+        body = &snapshot->encodings.msgpack;
+        contentType = "application/msgpack";
+        encoding = "-msgpack";
+    }
+
+    // Until the first rebuild succeeds there is no etag to revalidate against
+    if (!etag.empty()) {
+        etag.insert(etag.size() - 1, encoding);
+        if (req.get_header_value("If-None-Match") == etag) {
+            crow::response res(304);
+            res.set_header("ETag", etag);
+            return res;
+        }
+    }
 
-    crow::response res(buffer.str());
-    res.add_header("Content-Type", "application/json");
+    crow::response res(*body);
+    res.add_header("Content-Type", contentType);
+    if (!etag.empty()) {
+        res.add_header("ETag", etag);
+    }
+    res.add_header("Vary", "Accept");
     return res;
 }
 
@@ -240,36 +381,45 @@ crow::response API::subtitlesRequest(const crow::request& req, const std::string
     //    return crow::response(401, "Invalid authentication");
     //}
 
-    // Construct the full path to the MPD file
-    std::filesystem::path vttPath = std::filesystem::path(chunksPath) / media_id / "subtitles" / (language);
-
-    try {
-        // Read the MPD file
-        std::ifstream file(vttPath);
-        if (!file.is_open()) {
-            return crow::response(500, "Failed to open VTT file");
+    auto subtitles = subtitleCache.get(media_id, language);
+    if (!subtitles) {
+        return crow::response(404, "Subtitles not found");
+    }
+
+    // Optional ?start=<s>&end=<s> cuts a standalone window around the playhead
+    const char* startParam = req.url_params.get("start");
+    const char* endParam = req.url_params.get("end");
+    bool windowed = startParam || endParam;
+    double start = 0.0;
+    double end = 0.0;
+    if (windowed) {
+        try {
+            start = startParam ? std::stod(startParam) : 0.0;
+            end = endParam ? std::stod(endParam) : start + 60.0;
         }
-
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        std::string subtitlesContent = buffer.str();
-
-        // Ensure proper UTF-8 BOM if needed
-        if (subtitlesContent.length() >= 3 &&
-            (unsigned char)subtitlesContent[0] != 0xEF &&
-            (unsigned char)subtitlesContent[1] != 0xBB &&
-            (unsigned char)subtitlesContent[2] != 0xBF) {
-            subtitlesContent = std::string("\xEF\xBB\xBF") + subtitlesContent;
+        catch (const std::exception&) {
+            return crow::response(400, "Invalid subtitle window");
+        }
+        // stod accepts "nan" and "inf", and NaN slips past every comparison
+        if (!std::isfinite(start) || !std::isfinite(end) || start < 0.0 || end <= start) {
+            return crow::response(400, "Invalid subtitle window");
         }
+    }
 
-        crow::response res;
-        res.body = subtitlesContent;
-        res.set_header("Content-Type", "text/vtt");
+    std::string etag = windowed ? SubtitleCache::windowETag(*subtitles, start, end) : subtitles->etag;
+
+    // Clients that already hold this version only need a 304
+    if (req.get_header_value("If-None-Match") == etag) {
+        crow::response res(304);
+        res.set_header("ETag", etag);
         return res;
     }
-    catch (const std::exception& e) {
-        return crow::response(500, std::string("Error processing VTT file: ") + e.what());
-    }
+
+    crow::response res;
+    res.body = windowed ? SubtitleCache::window(*subtitles, start, end) : subtitles->body;
+    res.set_header("Content-Type", "text/vtt; charset=utf-8");
+    res.set_header("ETag", etag);
+    return res;
 }
 
 crow::response API::handleManifestRequest(const crow::request& req, const std::string& media_id) {
@@ -406,20 +556,7 @@ crow::response API::getMediaData(const crow::request& req) {
         return crow::response(401, "Invalid authentication");
     }
 
-    // Generate the media data JSON file
-    db.generateMediaDataJson();
-
-    // Read the generated file
-    std::ifstream file("media_data.json");
-    if (!file.is_open()) {
-        return crow::response(500, "Failed to open media_data.json");
-    }
-
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    file.close();
-
-    return crow::response{ buffer.str() };
+    return catalogResponse(req);
 }
 
 crow::response API::getMediaMetadata(const crow::request& req) {
@@ -436,20 +573,16 @@ crow::response API::getMediaMetadata(const crow::request& req) {
 
     std::string profileID = x["profileID"].s();
 
-    // Generate the user metadata JSON file based on userID and profileID
-    db.generateMediaMetadataJson(userID, profileID);
-
-    // Read the generated file
-    std::ifstream file("user_metadata.json");
-    if (!file.is_open()) {
-        return crow::response(500, "Failed to open user_metadata.json");
+    try {
+        // Served from memory; SQLite is only read the first time a profile asks
+        crow::response res(progressStore.serialize(userID, profileID));
+        res.add_header("Content-Type", "application/json");
+        return res;
+    }
+    catch (const CppSQLite3Exception& e) {
+        std::cerr << "Failed to read media metadata: " << e.errorMessage() << std::endl;
+        return crow::response(500, "Failed to read media metadata");
     }
-
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    file.close();
-
-    return crow::response{ buffer.str() };
 }
 
 crow::response API::updateMediaMetadata(const crow::request& req) {
@@ -464,32 +597,89 @@ crow::response API::updateMediaMetadata(const crow::request& req) {
         return crow::response(400, "Invalid JSON");
     }
 
-    std::string profileID = x["profileID"].s();
-    std::string mediaID = x["mediaID"].s();
-    double percentageWatched = std::stod(x["percentageWatched"].s());
-    std::string languageChosen = x["languageChosen"].s();
-    std::string subtitlesChosen = x["subtitlesChosen"].s();
-
+    MediaProgress progress;
+    progress.userID = userID;
+    progress.profileID = x["profileID"].s();
+    progress.mediaID = x["mediaID"].s();
+    progress.percentageWatched = std::stod(x["percentageWatched"].s());
+    progress.languageChosen = x["languageChosen"].s();
+    progress.subtitlesChosen = x["subtitlesChosen"].s();
 
+    // Coalesced in memory and written by the progress flusher
+    progressStore.record(progress);
 
     crow::json::wvalue response;
+    response["status"] = "success";
+    response["message"] = "Media metadata updated.";
+
+    return crow::response(std::move(response));  // Use std::move here
+}
 
 
 
-    int success = db.insertMediaMetadata(userID, profileID, mediaID, percentageWatched, languageChosen, subtitlesChosen);
-    if (success == 0) {
-        response["status"] = "success";
-        response["message"] = "Profile created successfully.";
+
+crow::response API::continueWatching(const crow::request& req) {
+    std::string userID;
+
+    if (!validateRequest(req, userID)) {
+        return crow::response(401, "Invalid authentication");
     }
-    else {
-        response["status"] = "error";
-        response["message"] = "Failed to update media metadata.";
+
+    auto x = crow::json::load(req.body);
+    if (!x) {
+        return crow::response(400, "Invalid JSON");
     }
 
-    return crow::response(std::move(response));  // Use std::move here
+    std::string profileID = x["profileID"].s();
+
+    try {
+        crow::response res(progressStore.continueWatching(userID, profileID, catalog.current()->version));
+        res.add_header("Content-Type", "application/json");
+        return res;
+    }
+    catch (const CppSQLite3Exception& e) {
+        std::cerr << "Failed to build continue watching: " << e.errorMessage() << std::endl;
+        return crow::response(500, "Failed to build continue watching");
+    }
 }
 
 
+crow::response API::serverStats(const crow::request& req) {
+    std::string userID;
+
+    if (!validateRequest(req, userID)) {
+        return crow::response(401, "Invalid authentication");
+    }
+
+    ConnectionPool::StatementStats statements = db.getStatementStats();
+    unsigned long long total = statements.compiled + statements.reused;
+
+    crow::json::wvalue response;
+    response["statements"]["compiled"] = statements.compiled;
+    response["statements"]["reused"] = statements.reused;
+    response["statements"]["reuseRate"] = total ? static_cast<double>(statements.reused) / total : 0.0;
+
+    CheckpointStats checkpoints = db.getCheckpointStats();
+    response["wal"]["journalMode"] = db.getJournalMode();
+    response["wal"]["pages"] = checkpoints.walPages;
+    response["wal"]["bytes"] = checkpoints.walBytes;
+    response["wal"]["fileBytes"] = checkpoints.walFileBytes;
+    response["wal"]["checkpoints"] = checkpoints.checkpoints;
+    response["wal"]["lastCheckpointMs"] = checkpoints.lastDurationMs;
+    response["wal"]["maxCheckpointMs"] = checkpoints.maxDurationMs;
+    response["database"]["queuedTasks"] = db.getQueuedTasks();
+
+    GroupCommitStats writes = db.getWriteStats();
+    response["writes"]["transactions"] = writes.transactions;
+    response["writes"]["committed"] = writes.writes;
+    response["writes"]["failed"] = writes.failedWrites;
+    response["writes"]["perTransaction"] = writes.transactions ? static_cast<double>(writes.writes) / writes.transactions : 0.0;
+
+    ConnectionPool::ReplicaStats replica = db.getReplicaStats();
+    response["replica"]["generation"] = replica.generation;
+    response["replica"]["bytes"] = replica.bytes;
+    return crow::response(std::move(response));
+}
 
 
 crow::response API::addProfile(const crow::request& req) {
@@ -542,7 +732,10 @@ crow::response API::deleteProfile(const crow::request& req) {
 
 
     bool success = db.deleteProfile(userID, profileID);
-    
+    if (success) {
+        progressStore.forget(userID, profileID);
+    }
+
 
     if (success) {
         response["status"] = "success";
@@ -569,8 +762,7 @@ crow::response API::listProfiles(const crow::request& req) {
 
   
 
-    std::vector<std::pair<std::string, std::string>> profiles;
-    db.getProfiles(userID, profiles);
+    std::vector<ProfileRecord> profiles = db.getProfiles(userID);
 
 
 
@@ -580,8 +772,8 @@ crow::response API::listProfiles(const crow::request& req) {
 
     for (const auto& profile : profiles) {
         crow::json::wvalue profileJson;
-        profileJson["profileID"] = profile.first;
-        profileJson["pictureID"] = profile.second;
+        profileJson["profileID"] = profile.profileID;
+        profileJson["pictureID"] = profile.pictureID;
         profileList.push_back(std::move(profileJson));  // Use std::move for inner elements
     }
 
@@ -596,6 +788,30 @@ bool API::checkPassword(const std::string& token, const std::string& userID) {
 }
 
 
+// Reads the wanted cover width from ?w= or a "width" body field, and WebP
+// support from the Accept header. Widths that don't parse mean the original;
+// anything wider than a screen is clamped.
+static CoverRequest coverRequestFor(const crow::request& req, const json& body) {
+    constexpr long long maxCoverWidth = 8192;
+    CoverRequest request;
+
+    long long width = 0;
+    const char* widthParam = req.url_params.get("w");
+    if (widthParam) {
+        const char* end = widthParam + std::strlen(widthParam);
+        if (std::from_chars(widthParam, end, width).ec != std::errc()) {
+            width = 0;
+        }
+    }
+    else if (body.is_object() && body.contains("width") && body["width"].is_number_integer()) {
+        width = body["width"].get<long long>();
+    }
+    request.width = static_cast<int>(std::clamp(width, 0LL, maxCoverWidth));
+
+    request.acceptWebp = req.get_header_value("Accept").find("image/webp") != std::string::npos;
+    return request;
+}
+
 crow::response API::getCoverImage(const crow::request& req, const std::string& id_raw) {
 
     std::string id = id_raw;
@@ -617,41 +833,78 @@ crow::response API::getCoverImage(const crow::request& req, const std::string& i
         return crow::response(401, "Invalid authentication");
     }
 
-    // Parse JSON body to get token and userID
-    auto bodyJson = json::parse(req.body, nullptr, false);
+    auto bodyJson = json::parse(req.body.empty() ? "{}" : req.body, nullptr, false);
     if (bodyJson.is_discarded()) {
         return crow::response(400, "Invalid JSON in request body");
     }
 
+    // Covers are preloaded, so this is a map lookup with no SQL or disk access
+    auto cover = coverStore.get(id, coverRequestFor(req, bodyJson));
+    if (!cover) {
+        return crow::response(404, "Cover image not found");
+    }
 
-    // Retrieve the full path to the image using DatabaseHandler
-    std::string fullPath = db.getImagePathById(id, coversPath);
+    if (req.get_header_value("If-None-Match") == cover->etag) {
+        crow::response res(304);
+        res.set_header("ETag", cover->etag);
+        return res;
+    }
 
-    if (fullPath.empty()) {
-        // If no image path is found, return a 404 error
-        return crow::response(404, "Cover image not found");
+    crow::response res(cover->bytes);
+    res.add_header("Content-Type", cover->contentType);
+    res.add_header("ETag", cover->etag);
+    res.add_header("Vary", "Accept");
+    return res;
+}
+
+
+crow::response API::getCoverBundle(const crow::request& req) {
+    std::string userID;
+
+    if (!validateRequest(req, userID)) {
+        return crow::response(401, "Invalid authentication");
     }
 
-    // Open the image file in binary mode
-    std::ifstream imageFile(fullPath, std::ios::binary);
-    if (!imageFile.is_open()) {
-        // Return 404 if the image file is missing on the server
-        return crow::response(404, "Image file not found on server");
+    auto bodyJson = json::parse(req.body.empty() ? "{}" : req.body, nullptr, false);
+    if (bodyJson.is_discarded() || !bodyJson.is_object()) {
+        return crow::response(400, "Invalid JSON in request body");
+    }
+
+    std::uint64_t current = coverStore.version();
+    std::string version = std::to_string(current);
+
+    bool subset = bodyJson.contains("ids") && bodyJson["ids"].is_array();
+
+    // A client that already holds every cover at this version has nothing to
+    // fetch. The version says nothing about which ids a subset covered, so
+    // subset requests are always answered in full.
+    if (!subset && bodyJson.contains("version") && bodyJson["version"].is_number_unsigned() &&
+        bodyJson["version"].get<std::uint64_t>() == current) {
+        crow::response res(304);
+        res.set_header("X-Cover-Version", version);
+        return res;
     }
 
-    // Read the image content
-    std::stringstream buffer;
-    buffer << imageFile.rdbuf();
-    imageFile.close();
+    crow::response res;
+    if (subset) {
+        std::vector<std::string> ids;
+        for (const auto& id : bodyJson["ids"]) {
+            if (id.is_string()) {
+                ids.push_back(id.get<std::string>());
+            }
+        }
+        res.body = coverStore.buildBundle(ids, coverRequestFor(req, bodyJson));
+    }
+    else {
+        res.body = *coverStore.fullBundle(coverRequestFor(req, bodyJson));
+    }
 
-    // Create the response with appropriate content type
-    crow::response res(buffer.str());
-    res.add_header("Content-Type", "image/jpeg");  // Adjust if images may be of a different format
+    res.set_header("Content-Type", "application/octet-stream");
+    res.set_header("X-Cover-Version", version);
     return res;
 }
 
 
-
 std::string API::getPublicIP(const std::string& domain) {
     WSADATA wsaData;
     int res = WSAStartup(MAKEWORD(2, 2), &wsaData);
@@ -2,12 +2,18 @@
 #define API_H
 
 #include <crow.h>
+#include <functional>
 #include <string>
+#include "CatalogCache.h"
+#include "CoverStore.h"
 #include "DatabaseHandler.h"
+#include "ProgressStore.h"
+#include "SubtitleCache.h"
 
 class API {
 public:
-    API(DatabaseHandler& dbHandler, const std::string& coversPath, const std::string& chunksPath, const std::string& domain);
+    API(DatabaseHandler& dbHandler, const std::string& coversPath, const std::string& chunksPath, const std::string& domain,
+        std::chrono::milliseconds progressFlushInterval = std::chrono::milliseconds(5000));
     void run(int port);
     std::string getPublicIP(const std::string& domain);
 
@@ -17,6 +23,11 @@ private:
     const std::string chunksPath;
 	const std::string domain;
 
+    SubtitleCache subtitleCache;
+    CoverStore coverStore;
+    CatalogCache catalog;
+    ProgressStore progressStore;
+
     crow::response downloadMediaData(const crow::request& req);
     crow::response downloadMediaMetadata(const crow::request& req);
 
@@ -26,15 +37,23 @@ private:
 
     crow::response serveFile(const std::string& path);
 
+    // Handlers that run SQL are completed from a database thread
+    void respondFromDatabase(crow::response& res, std::function<crow::response()> handler);
+    static bool catalogNeedsDatabase(const crow::request& req);
+
     crow::response getMediaData(const crow::request& req);
+    crow::response catalogResponse(const crow::request& req);
     crow::response getMediaMetadata(const crow::request& req);
     crow::response updateMediaMetadata(const crow::request& req);
+    crow::response continueWatching(const crow::request& req);
+    crow::response serverStats(const crow::request& req);
 
     crow::response addProfile(const crow::request& req);
     crow::response deleteProfile(const crow::request& req);
     crow::response listProfiles(const crow::request& req);
 
     crow::response getCoverImage(const crow::request& req, const std::string& id);
+    crow::response getCoverBundle(const crow::request& req);
 
     std::unordered_map<std::string, std::string> passwords;
 